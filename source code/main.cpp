@@ -18,7 +18,8 @@ Because the study covers a broad evaluation scope, this repository provides sele
 #include "cpr/include/cpr/cpr.h"
 #include <iostream>
 #include <string>
-// #include <sstream>
+#include <sstream>
+#include <fstream>
 #include "ilcplex/ilocplex.h"
 ILOSTLBEGIN
 #include <mutex> // For std::unique_lock
@@ -34,6 +35,24 @@ ILOSTLBEGIN
 #include <algorithm>
 #include <boost/asio.hpp>
 #include <limits>
+#include <stdexcept>
+#include <array>
+#include <tuple>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <random>
+#include <numeric>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
 typedef IloArray<IloArray<IloIntVarArray>> IloIntVarArray3;
 typedef IloArray<IloArray<IloArray<IloIntVarArray>>> IloIntVarArray4;
@@ -59,24 +78,428 @@ vector<int> mu_bar_c; // total intensity of video qualtiy swithes
 // total video quality isolation till now. 
 vector<int> v_bar_c; 
 
-//Used to get results
-vector<std::chrono::duration<double>> optimizer_runtimes;
-vector<std::chrono::duration<double>> flow_assignment_runtimes;
-vector<vector<int>> video_quality;
+#ifdef FROG_COUNT_ALLOCS
+// -DFROG_COUNT_ALLOCS counts heap allocations of the process (Concert's included), optimizer() prints them per cycle
+std::atomic<long long> heap_allocations{0};
+void *operator new(std::size_t size)
+{
+    heap_allocations++;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+#endif
+
+// -1 if allocations aren't counted
+long long heap_allocation_count()
+{
+#ifdef FROG_COUNT_ALLOCS
+    return heap_allocations.load();
+#else
+    return -1;
+#endif
+}
+
+// Last capacity values pushed, oldest first. Runtime logs are kept in these so a long running optimizer's memory stays flat.
+template <typename T>
+class Ring
+{
+public:
+    explicit Ring(size_t capacity) : items(capacity) {}
+
+    void emplace_back(T item)
+    {
+        items[pushed++ % items.size()] = item;
+    }
+    size_t size() const { return std::min(pushed, items.size()); }
+    bool empty() const { return pushed == 0; }
+    void clear() { pushed = 0; }
+    T &operator[](size_t i) { return items[(pushed - size() + i) % items.size()]; }
+    T &back() { return items[(pushed - 1) % items.size()]; }
+
+    struct Iterator
+    {
+        Ring *ring;
+        size_t i;
+        T &operator*() { return (*ring)[i]; }
+        Iterator &operator++()
+        {
+            i++;
+            return *this;
+        }
+        bool operator!=(const Iterator &other) const { return i != other.i; }
+    };
+    Iterator begin() { return {this, 0}; }
+    Iterator end() { return {this, size()}; }
+
+private:
+    std::vector<T> items;
+    size_t pushed = 0;
+};
+
+// Per segment results of the last capacity segments in a memory-mapped ring: phase timings of the cycle and quality of each client.
+// With a file the ring is a shared mapping of it, the kernel writes it back and another process can read it (--metrics-read=<file>)
+// while the optimizer runs. Slots are guarded like a seqlock: a slot's segment is -1 while it's written, readers copy a slot and
+// keep it if its segment is the same before and after the copy.
+class Metrics_Store
+{
+public:
+    enum Phase
+    {
+        multiserver_phase,
+        master_phase,
+        flow_assignment_phase,
+        cycle_phase,   // solve stage of the cycle, multiserver to publish hand-off
+        publish_phase, // cycle start to last message sent
+        master_nodes_phase,
+        phase_qty
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t capacity;
+        uint32_t clients;
+        uint32_t phases;
+        uint32_t slot_bytes;
+        std::atomic<int64_t> last_segment; // last segment that's finished, -1 if none
+    };
+
+    struct Slot
+    {
+        std::atomic<int64_t> segment;
+        float phase_ms[phase_qty];
+        uint8_t quality[1]; // clients entries
+    };
+
+    Metrics_Store() = default;
+    Metrics_Store(const Metrics_Store &) = delete;
+    ~Metrics_Store() { close(); }
+
+    // path is empty for an anonymous mapping
+    void open(int clients, int capacity, const std::string &path)
+    {
+        close();
+        capacity = std::max(capacity, 4); // segments in the pipeline (solved, queued, publishing) must not share a slot
+        size_t slot_bytes = (offsetof(Slot, quality) + clients + 7) / 8 * 8;
+        size_t bytes = sizeof(Header) + slot_bytes * capacity;
+        void *data;
+        if (path.empty())
+            data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        else
+        {
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0 || ftruncate(fd, bytes) != 0)
+            {
+                if (fd >= 0)
+                    ::close(fd);
+                throw std::runtime_error("can't create metrics file " + path);
+            }
+            data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+        }
+        if (data == MAP_FAILED)
+            throw std::runtime_error("can't map metrics store of " + std::to_string(bytes) + " bytes");
+        map(data, bytes);
+        std::memcpy(header->magic, "FROGMET1", 8);
+        header->capacity = capacity;
+        header->clients = clients;
+        header->phases = phase_qty;
+        header->slot_bytes = slot_bytes;
+        header->last_segment.store(-1);
+        for (int i = 0; i < capacity; i++)
+            slot(i)->segment.store(-1);
+    }
+
+    // maps a metrics file of a running optimizer read only
+    void open_reader(const std::string &path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header))
+        {
+            if (fd >= 0)
+                ::close(fd);
+            throw std::runtime_error("can't open metrics file " + path);
+        }
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("can't map metrics file " + path);
+        map(data, st.st_size);
+        if (std::memcmp(header->magic, "FROGMET1", 8) != 0 || header->phases != phase_qty ||
+            sizeof(Header) + (size_t)header->slot_bytes * header->capacity > mapped_bytes)
+            throw std::runtime_error(path + " isn't a metrics file of this version");
+    }
+
+    bool is_open() const { return header != nullptr; }
+    int capacity() const { return header->capacity; }
+    int clients() const { return header->clients; }
+    int64_t last_segment() const { return header->last_segment.load(std::memory_order_acquire); }
+
+    // solve stage: the segment's slot is taken, qualities of the segment are written to it by master
+    void begin_segment(int64_t segment)
+    {
+        if (!header)
+            return;
+        writing = slot(segment % header->capacity);
+        writing->segment.store(-1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memset(writing->quality, 0, header->clients);
+    }
+
+    void set_quality(int c, int quality)
+    {
+        if (writing)
+            writing->quality[c] = quality;
+    }
+
+    // publish stage: timings are written and the slot is made readable
+    void finish_segment(int64_t segment, const float (&phase_ms)[phase_qty])
+    {
+        if (!header)
+            return;
+        Slot *s = slot(segment % header->capacity);
+        std::memcpy(s->phase_ms, phase_ms, sizeof(phase_ms));
+        s->segment.store(segment, std::memory_order_release);
+        header->last_segment.store(segment, std::memory_order_release);
+    }
+
+    // copies a finished segment, false if it isn't in the ring or it's being overwritten
+    bool read_segment(int64_t segment, float (&phase_ms)[phase_qty], std::vector<uint8_t> &quality) const
+    {
+        const Slot *s = slot(segment % header->capacity);
+        if (s->segment.load(std::memory_order_acquire) != segment)
+            return false;
+        std::memcpy(phase_ms, s->phase_ms, sizeof(phase_ms));
+        quality.assign(s->quality, s->quality + header->clients);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s->segment.load(std::memory_order_relaxed) == segment;
+    }
+
+    void close()
+    {
+        if (header)
+            munmap(header, mapped_bytes);
+        header = nullptr;
+        writing = nullptr;
+    }
+
+private:
+    void map(void *data, size_t bytes)
+    {
+        header = static_cast<Header *>(data);
+        mapped_bytes = bytes;
+    }
+    Slot *slot(int i) const
+    {
+        return reinterpret_cast<Slot *>(reinterpret_cast<char *>(header + 1) + (size_t)header->slot_bytes * i);
+    }
+
+    Header *header = nullptr;
+    size_t mapped_bytes = 0;
+    Slot *writing = nullptr;
+};
+
+//Used to get results. Logs keep the last runtime_log_qty cycles, per segment history is in metrics_store.
+size_t const runtime_log_qty = 4096;
+Ring<std::chrono::duration<double>> optimizer_runtimes(runtime_log_qty);
+Ring<std::chrono::duration<double>> flow_assignment_runtimes(runtime_log_qty);
+Ring<std::chrono::duration<double>> publish_latencies(runtime_log_qty);   // cycle start to last message sent of each segment
+Ring<std::chrono::duration<double>> multiserver_runtimes(runtime_log_qty); // patch + solve time of the live multiserver LP
+Ring<std::chrono::duration<double>> link_event_reactions(runtime_log_qty); // link event posted to multiserver re-solved
+Ring<std::chrono::duration<double>> master_solve_runtimes(runtime_log_qty); // CPLEX solve time of the live master MILP
+Ring<long long> master_nodes(runtime_log_qty);                              // branch and bound nodes of the live master MILP
+Metrics_Store metrics_store;                                                // quality of each client and phase timings of the last segments
+
+// Runtime options. Set from command line arguments in main()
+struct Frog_Options
+{
+    int requests_qty = 5000;   // --clients=<n>
+    std::string topology_file; // --topo=<file>, built-in topology is used if empty
+    std::string lp_solver = "cplex"; // --lp-solver=cplex|paths|native, arc or candidate path LP, or in-process flow engine for the multiserver stage
+    int k_paths = 4;                 // --k-paths=K, candidate paths of each (sssw, cssw) pair of --lp-solver=paths
+    std::string master_model = "full"; // --master=full|aggregated|greedy|lagrangian|partitioned, per client or class-aggregated master MILP, MILP-free greedy,
+                                       // its Lagrangian decomposition or per client group MILPs
+    int threads = 0;                   // --threads=N, workers of the lagrangian and partitioned masters' pool, 0 = hardware concurrency
+    int groups = 8;                    // --groups=K, client groups of the partitioned master
+    std::string switch_model = "abs"; // --switch-model=abs|linear, a_c = |d_c| by IloAbs, or by up/down switch variables with linear (opt-in)
+    std::string catalog_file = "segments.cat"; // --catalog=<file>, segment size catalog, built from ./mediaServer if it doesn't exist
+    std::string video = "BBB";                 // --video=<name>, video of the catalog requested by clients
+    int history = 256;                 // --history=N, segments kept in the metrics store
+    std::string metrics_file;          // --metrics-file=<file>, metrics store is mapped to this file, it's kept in memory if empty
+    std::string quality_model = "layers"; // --quality-model=layers|integer, binary w_s_cl or integer q_c with w_s_cl relaxed where it's exact
+    std::string mip_start = "repair";  // --mip-start=off|auto|checkfeas|solvefixed|solvemip|repair|nocheck, effort of previous segment's MIP start
+    int mip_start_reference = 0;       // --mip-start-reference=N, every Nth master solve runs without MIP starts as the reference of the
+                                       // "ms saved" report, 0 = never, live cycles always get their starts
+    std::string link_events_file;      // --link-events=<file>, link events replayed while the optimizer runs, see read_link_events()
+};
+Frog_Options frog_options;
+
+// Read-only view of a contiguous index list, used to iterate neighbours without copying
+struct Index_Range
+{
+    const int *first;
+    const int *last;
+    const int *begin() const { return first; }
+    const int *end() const { return last; }
+    int size() const { return last - first; }
+};
+
+// Contiguous adjacency lists indexed by e index. Row i is indices[offsets[i]] ... indices[offsets[i + 1] - 1].
+// Rows are appended in e index order with add() and end_row().
+struct Flat_Adjacency
+{
+    std::vector<int> offsets = {0};
+    std::vector<int> indices;
+
+    Index_Range operator[](int i) const
+    {
+        return {indices.data() + offsets[i], indices.data() + offsets[i + 1]};
+    }
+    void add(int j) { indices.emplace_back(j); }
+    void end_row() { offsets.emplace_back(indices.size()); }
+    void clear() // keeps the buffers for the next rows
+    {
+        offsets.resize(1);
+        indices.clear();
+    }
+};
+
+// Topology read from a topology description file. Servers come first in e index, then sws ordered as
+// server side sws, other sws and client side sws, since r_sc indexes are derived from these positions.
+struct Topology_Description
+{
+    std::vector<std::string> server_ips;
+    std::vector<std::string> sw_names;
+    int server_side_qty = 0;
+    int client_side_qty = 0;
+    std::vector<std::array<int, 3>> links; // e index of both ends and link capacity
+    int access_capacity = 1000;            // capacity of each client's access link
+};
+
+// Reads a topology description file. One statement per line, '#' starts a comment:
+//   server <name> <ip>
+//   switch <name> [server_side | client_side]
+//   link <name> <name> <capacity>     (same capacity in both directions)
+//   access_capacity <capacity>
+Topology_Description read_topology_file(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("can't open topology file " + path);
+
+    std::vector<std::pair<std::string, std::string>> server_records; // name, ip
+    std::vector<std::pair<std::string, int>> sw_records;             // name, role (0: server side, 1: other, 2: client side)
+    std::vector<std::tuple<std::string, std::string, int>> link_records;
+    Topology_Description topology;
+
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line))
+    {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string keyword;
+        if (!(words >> keyword))
+            continue;
+
+        std::string name, other;
+        int capacity;
+        if (keyword == "server" && words >> name >> other)
+        {
+            server_records.emplace_back(name, other);
+        }
+        else if (keyword == "switch" && words >> name)
+        {
+            int role = 1;
+            if (words >> other)
+            {
+                if (other == "server_side")
+                    role = 0;
+                else if (other == "client_side")
+                    role = 2;
+                else
+                    throw std::runtime_error(path + ":" + std::to_string(line_no) + ": unknown switch role " + other);
+            }
+            sw_records.emplace_back(name, role);
+        }
+        else if (keyword == "link" && words >> name >> other >> capacity)
+        {
+            link_records.emplace_back(name, other, capacity);
+        }
+        else if (keyword == "access_capacity" && words >> capacity)
+        {
+            topology.access_capacity = capacity;
+        }
+        else
+        {
+            throw std::runtime_error(path + ":" + std::to_string(line_no) + ": can't parse \"" + line + "\"");
+        }
+    }
+
+    std::stable_sort(sw_records.begin(), sw_records.end(), [](const std::pair<std::string, int> &a, const std::pair<std::string, int> &b)
+                     { return a.second < b.second; });
+
+    std::unordered_map<std::string, int> e_index; // device name -> e index
+    for (auto &server : server_records)
+    {
+        e_index[server.first] = topology.server_ips.size();
+        topology.server_ips.emplace_back(server.second);
+    }
+    for (auto &sw : sw_records)
+    {
+        e_index[sw.first] = server_records.size() + topology.sw_names.size();
+        topology.sw_names.emplace_back(sw.first);
+        topology.server_side_qty += sw.second == 0;
+        topology.client_side_qty += sw.second == 2;
+    }
+    if (e_index.size() != server_records.size() + sw_records.size())
+        throw std::runtime_error(path + ": device names must be unique");
+
+    for (auto &link : link_records)
+    {
+        auto i = e_index.find(std::get<0>(link));
+        auto j = e_index.find(std::get<1>(link));
+        if (i == e_index.end() || j == e_index.end())
+            throw std::runtime_error(path + ": link " + std::get<0>(link) + " - " + std::get<1>(link) + " has an undeclared end");
+        topology.links.push_back({i->second, j->second, std::get<2>(link)});
+    }
+
+    if (topology.server_ips.empty() || topology.server_side_qty == 0 || topology.client_side_qty == 0)
+        throw std::runtime_error(path + ": at least one server, one server side switch and one client side switch are needed");
+    return topology;
+}
 
 //Used to keep network topology information and related opt variables and constants
 class Net_Topo
 {
 public:
-    Net_Topo()
+    Net_Topo(int requests = 5000, const std::string &topology_file = "")
     {
-        requests_qty = 5000;// Total client number. we can't scale up to 5000 client, but 4000 client were good to go in the test with the automated requests not with the mininet simulation. 50 client were OK with mininet simulation.  
-        srv_qty = servers.size();
+        requests_qty = requests;// Total client number. we can't scale up to 5000 client, but 4000 client were good to go in the test with the automated requests not with the mininet simulation. 50 client were OK with mininet simulation.  
+        Topology_Description topology;
+        if (topology_file.empty())
+        {
+            srv_qty = servers.size();
+            sw_qty = 6;
+        }
+        else
+        {
+            topology = read_topology_file(topology_file);
+            servers = set<string>(topology.server_ips.begin(), topology.server_ips.end());
+            srv_qty = topology.server_ips.size();
+            sw_qty = topology.sw_names.size();
+        }
         optimizer_qty = optimizers.size();
         hosts_qty = requests_qty + srv_qty + optimizer_qty;
         client_qty = hosts_qty - (srv_qty + optimizer_qty);
-        sw_qty = 6;
         vertex_qty = hosts_qty + sw_qty - optimizer_qty;
+        core_qty = srv_qty + sw_qty; // clients are not graph vertices, they are kept in client_attachments
 
         for (int i = 0; i < requests_qty; i++)
         {
@@ -85,22 +508,9 @@ public:
             mu_bar_c.emplace_back(0);
             v_bar_c.emplace_back(0);
         }
-        for (int i = 0; i < vertex_qty; ++i)
-        {
-            e.emplace_back(std::vector<int>(vertex_qty, 0));
-            // link_capacity.emplace_back(std::vector<int>(vertex_qty, 0));
-            link_capacity.emplace_back(std::vector<int>(vertex_qty, 0));
-            b_ij.emplace_back(std::vector<int>(vertex_qty, 0));
-        }
-
-        for (int i = 0; i < srv_qty + sw_qty; ++i)
-        {
-            e.emplace_back(std::vector<int>(srv_qty + sw_qty, 0));
-        }
-
         for (int i = 0; i < srv_qty + sw_qty; ++i) // No need client and server connedted ports so sws hold the connections. But servers are included due to correlation of index numbers between e array and this array
         {
-            ports.emplace_back(std::vector<int>(vertex_qty));
+            ports.emplace_back(std::vector<int>(core_qty));
         }
         /*
             cout << "2D Empty Edge Vector"
@@ -116,15 +526,20 @@ public:
         */
         // get_sws_onos();
         // get_hosts_onos(); // gets client and servers from onos and updates e array - clients_index_update();
+        if (!topology_file.empty())
+        {
+            set_x_y_sws(topology);
+            set_e_index(topology);
+            set_client_attachments();
+            set_flat_indexes();
+            set_link_capacity(topology);
+            set_b_ij();
+            return;
+        }
         set_x_y_sws(); // assings X and Y, e ids to ServerSideOFSWs and ClientSideOFSWs sets
         set_e_index();
-
-        set_OF_SWs();          // All sws but Y
-        set_OF_SWs_No_SSSWs(); // All sws but X and Y
-        set_C_OF_SWs_Connections();
-
-        set_Server_OF_SWs_Connections();
-        set_ServerSideOFSWs_Connected_Servers();
+        set_client_attachments();
+        set_flat_indexes(); // OF_SWs (all sws but Y), OF_SWs_No_SSSWs (all sws but X and Y), role bitsets and connection lists
         
         //Edge capacities. Since ONOS doesn't provide exact BW, we provide them manually.
         // std::vector<int> bandwith = {100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100};
@@ -143,6 +558,7 @@ public:
     }; // end of Net_Topo Constructor
 
     int vertex_qty;
+    int core_qty; // servers and sws, the vertices of the core graph
     int srv_qty;
     int client_qty;
     int sw_qty;
@@ -151,7 +567,6 @@ public:
     int requests_qty;
     std::vector<int> sws; // Contains sws IDs
 
-    vector<vector<int>> b_ij; // avaiable bw
     std::vector<std::vector<std::vector<int>>> avg_b_ij;
     std::vector<std::vector<int>> pre_bytesSent;
 
@@ -159,20 +574,17 @@ public:
     // vector<vector<int>> total_b_bar_cl_at_t_1_on_ij; // used bw at t-1 time period.
     // vector<vector<int>> avg_bw_usage;                // used to calculate avarage bw usage on edges
     int calls_of_set_b_ij = 0;
-    // vector<vector<int>> link_capacity;
-    vector<vector<int>> link_capacity;
     map<string, int> swPort_con_sw_e_index; // sw_id+port and connected sw at that port's e index are mapped
     map<string, int> host_con_swPort_host_e_index;
     map<string, int> sw_id_e_index; // holds sw id and it's e index
     map<int, string> sw_e_index_id; // holds sw e index and it's id
     // ALL OF_SWs - CLIENT SIDE OF_SWs vector
-    bool i_j_equal = false;
-    vector<int> OF_SWs;                             // All OFSWs except client side OFSWs
-    vector<int> OF_SWs_No_SSSWs;                    // All OFSWs except client side and server side OFSWs
-    map<int, set<int>> OF_SWs_Connections;          // All OFSWs except client side OFSWs and their connections index in e
-    map<int, set<int>> OF_SWs_No_SSSWs_Connections; // All OFSWs except client side and server side OFSWs and their connections index in e
-    map<int, set<int>> C_OF_SWs_Connections;        // Client side ofsw connections to other ofsws
-    map<int, set<int>> Server_OF_SWs_Connections;   // Client side ofsw connections to other ofsws
+    vector<int> OF_SWs;                         // All OFSWs except client side OFSWs
+    vector<int> OF_SWs_No_SSSWs;                // All OFSWs except client side and server side OFSWs
+    Flat_Adjacency OF_SWs_Connections;          // All OFSWs except client side OFSWs and their connections index in e
+    Flat_Adjacency OF_SWs_No_SSSWs_Connections; // All OFSWs except client side and server side OFSWs and their connections index in e
+    Flat_Adjacency C_OF_SWs_Connections;        // Client side ofsw connections to other ofsws
+    Flat_Adjacency Server_OF_SWs_Connections;   // Server side ofsw connections to other ofsws
     // map<int, set<int>> ServerSideOFSWs_Connected_Servers;
     map<string, int> clients_e_index; // client ip addresses and their index in e
     // map<string, int> server_e_index;
@@ -183,8 +595,7 @@ public:
     // set<string> servers = {"10.0.0.200", "10.0.0.201", "10.0.0.202", "10.0.0.203"}; // server ip addresses
     set<string> optimizers = {"10.0.0.100"};              // server ip addresses
     map<string, set<int>> srv_ip_con_sws_e_index;         // holds server ip and connected switchs e index
-    map<int, set<int>> ServerSideOFSWs_Connected_Servers; // Server side OFSWs and connected server set index in e
-    map<int, set<int>> N_i;                               // Client side OFSWs and connected client set index in e
+    Flat_Adjacency ServerSideOFSWs_Connected_Servers;     // Server side OFSWs and connected server set index in e
     map<int, string> srv_e_index_ip;                      // holds server e index and corresponding ip address
     map<int, set<int>> srv_con_sws_e_index;               // holds server and connected switchs e index
     map<int, int> srv_con_sws_e_index2;                   // holds server and connected switch e index
@@ -192,16 +603,114 @@ public:
     map<int, int> client_con_sw_e_index;                  // holds client and connected switchs e index
     map<string, int> client_ip_con_sw_e_index;            // holds client ip and connected switchs e index
     // set<int> C;                                      // client side OFSWs index in e
-    set<int> ServerSideOFSWs; // server side OFSWs index in e
-    set<int> ClientSideOFSWs; // client side OFSWs index in e
-
-    vector<vector<int>> e; //Holds connections in a 2D array
-    // vector<vector<int>> e(vertex_qty, vector<int>(vertex_qty, 0));
+    vector<int> ServerSideOFSWs;     // server side OFSWs index in e
+    vector<int> ClientSideOFSWs;     // client side OFSWs index in e
+    std::vector<bool> server_side_sw; // role bitset, e index -> is server side OFSW
+    std::vector<bool> client_side_sw; // role bitset, e index -> is client side OFSW
+
+    // Core graph (servers and sws) connections are kept as a compressed sparse row (CSR) adjacency instead of vertex_qty x vertex_qty matrices.
+    // Neighbours of vertex i are col_idx[row_ptr[i]] ... col_idx[row_ptr[i + 1] - 1], sorted ascending, and every CSR edge k
+    // has its link capacity in edge_capacity[k] and its avaiable bw in edge_b[k]. Memory scales with edge count, not vertex_qty^2.
+    std::vector<int> row_ptr;
+    std::vector<int> col_idx;
+    std::vector<int> edge_capacity; // link capacity of each edge
+    std::vector<int> edge_b;        // avaiable bw of each edge
     std::vector<std::vector<int>> ports; // holds sws connection ports to other devices
 
+    Index_Range neighbours(int i) const
+    {
+        return {col_idx.data() + row_ptr[i], col_idx.data() + row_ptr[i + 1]};
+    }
+
+    // returns CSR edge index of i->j connection or -1 if i and j are not connected
+    int edge_index(int i, int j) const
+    {
+        auto row_begin = col_idx.begin() + row_ptr[i];
+        auto row_end = col_idx.begin() + row_ptr[i + 1];
+        auto itr = std::lower_bound(row_begin, row_end, j);
+        if (itr == row_end || *itr != j)
+            return -1;
+        return itr - col_idx.begin();
+    }
+
+    bool has_edge(int i, int j) const { return edge_index(i, j) >= 0; }
+
+    // i and j are e indexes connected in both directions, link events have to name such a link
+    bool has_link(int i, int j) const
+    {
+        int vertex_qty = row_ptr.size() - 1;
+        return i >= 0 && i < vertex_qty && j >= 0 && j < vertex_qty && has_edge(i, j) && has_edge(j, i);
+    }
+
+    int capacity(int i, int j) const
+    {
+        int k = edge_index(i, j);
+        return k < 0 ? 0 : edge_capacity[k];
+    }
+
+    int available_bw(int i, int j) const
+    {
+        int k = edge_index(i, j);
+        return k < 0 ? 0 : edge_b[k];
+    }
+
+    int edge_qty() const { return col_idx.size(); }
+
+    // Clients are attached to client side OFSWs instead of being core graph vertices.
+    // client_attachments[c] holds the clients of c. client side OFSW (e index c + srv_qty + OF_SWs.size()) and their access link capacities.
+    struct Client_Attachments
+    {
+        std::vector<int> clients;         // client numbers, 0 ... requests_qty - 1
+        std::vector<int> access_capacity; // access link capacity of each attached client
+    };
+    std::vector<Client_Attachments> client_attachments;
+    std::vector<int> client_cssw; // client number -> index of its client side OFSW in client_attachments (and in r_sc)
+
+    // bytes held by the topology store (used by the topology benchmark)
+    size_t topology_bytes() const
+    {
+        size_t bytes = (row_ptr.capacity() + col_idx.capacity() + edge_capacity.capacity() + edge_b.capacity() + client_cssw.capacity()) * sizeof(int);
+        for (auto &attachments : client_attachments)
+        {
+            bytes += (attachments.clients.capacity() + attachments.access_capacity.capacity()) * sizeof(int);
+        }
+        return bytes;
+    }
+
+    // bytes held by the core graph only
+    size_t core_bytes() const
+    {
+        return (row_ptr.capacity() + col_idx.capacity() + edge_capacity.capacity() + edge_b.capacity()) * sizeof(int);
+    }
+
+    // builds CSR arrays from a directed edge list. Duplicated edges are dropped.
+    void build_csr(std::vector<std::pair<int, int>> &edges)
+    {
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        row_ptr.assign(core_qty + 1, 0);
+        for (auto &edge : edges)
+        {
+            row_ptr[edge.first + 1]++;
+        }
+        for (int i = 0; i < core_qty; i++)
+        {
+            row_ptr[i + 1] += row_ptr[i];
+        }
+
+        col_idx.resize(edges.size());
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            col_idx[k] = edges[k].second; // edges are sorted so each row is filled in order
+        }
+        edge_capacity.assign(edges.size(), 0);
+        edge_b.assign(edges.size(), 0);
+    }
+
     void set_e_index()
     {
-        e = {
+        std::vector<std::vector<int>> core_e = {
             // srv1     s1 s2 s3 s4 s5 s6
             {0, 1, 0, 0, 0, 0, 0}, // srv1
             {1, 0, 1, 1, 1, 0, 0}, // s1
@@ -212,42 +721,18 @@ public:
             {0, 0, 0, 1, 1, 1, 0}  // s6
         };
 
-        e.resize(vertex_qty); // Resize to 4 rows
-        for (auto &row : e)
-        {
-            row.resize(vertex_qty, 0); // Fill new elements with value 1
-        }
-
-        for (int i = srv_qty + sw_qty; i < vertex_qty; i++)
-        {
-            for (int j = srv_qty + sw_qty; j < vertex_qty; j++)
-            {
-                e[i][j] = 0;
-            }
-        }
-        // client connection capacity - ClientSideOFSWs
-        for (int i = srv_qty + sw_qty; i < vertex_qty; i++)
-        {
-            for (auto j : ClientSideOFSWs)
-            {
-                // cout <<    "setting client's e index - client(i) " << i << " - sw(j) " << j <<"\n";
-                e[i][j] = 1;
-                e[j][i] = 1;
-            }
-        }
-
-        /*
-        cout << "e index\n";
-        for (int i = 0; i < vertex_qty; i++)
+        std::vector<std::pair<int, int>> edges;
+        for (int i = 0; i < (int)core_e.size(); i++)
         {
-            for (int j = 0; j < vertex_qty; j++)
+            for (int j = 0; j < (int)core_e[i].size(); j++)
             {
-                cout << e[i][j] << "\t";
+                if (core_e[i][j] == 1)
+                {
+                    edges.emplace_back(i, j);
+                }
             }
-            cout << "\n";
         }
-        cout << "\n";
-        */
+        build_csr(edges);
         /*
         e = {
     // srv1     s1 s2 s3 s4 s5 s6 c1 c2 c3 c4
@@ -266,11 +751,58 @@ public:
         */
     } // end of set_e_index func
 
+    void set_e_index(const Topology_Description &topology)
+    {
+        std::vector<std::pair<int, int>> edges;
+        for (auto &link : topology.links)
+        {
+            edges.emplace_back(link[0], link[1]);
+            edges.emplace_back(link[1], link[0]);
+        }
+        build_csr(edges);
+    }
+
+    // attaches each client to a client side OFSW. Clients are spread over client side OFSWs in turn.
+    void set_client_attachments()
+    {
+        client_attachments.assign(ClientSideOFSWs.size(), Client_Attachments());
+        client_cssw.resize(requests_qty);
+        for (int c = 0; c < requests_qty; c++)
+        {
+            int cssw = c % ClientSideOFSWs.size();
+            // cout <<    "attaching client " << c << " to cssw " << cssw <<"\n";
+            client_cssw[c] = cssw;
+            client_attachments[cssw].clients.emplace_back(c);
+            client_attachments[cssw].access_capacity.emplace_back(0);
+        }
+    }
+
     // sets srv site and client site sws
     void set_x_y_sws()
     {
-        ServerSideOFSWs.emplace(srv_qty);
-        ClientSideOFSWs.emplace(srv_qty + sw_qty - 1);
+        ServerSideOFSWs.emplace_back(srv_qty);
+        ClientSideOFSWs.emplace_back(srv_qty + sw_qty - 1);
+        int s = 0;
+        for (auto &ip : servers)
+        {
+            srv_e_index_ip[s++] = ip;
+        }
+    }
+
+    void set_x_y_sws(const Topology_Description &topology)
+    {
+        for (int i = 0; i < topology.server_side_qty; i++)
+        {
+            ServerSideOFSWs.emplace_back(srv_qty + i);
+        }
+        for (int i = sw_qty - topology.client_side_qty; i < sw_qty; i++)
+        {
+            ClientSideOFSWs.emplace_back(srv_qty + i);
+        }
+        for (int s = 0; s < srv_qty; s++)
+        {
+            srv_e_index_ip[s] = topology.server_ips[s];
+        }
     }
 
     void set_link_capacity(std::vector<int> bw /*Link capacities*/)
@@ -288,10 +820,10 @@ public:
         {
             for (int j = i + 1; j < srv_qty + sw_qty; j++)
             {
-                if (e[i][j] == 1)
+                if (has_edge(i, j))
                 {
-                    link_capacity[i][j] = e[i][j] * bw[k] * toByte;
-                    link_capacity[j][i] = e[j][i] * bw[k] * toByte;
+                    edge_capacity[edge_index(i, j)] = bw[k] * toByte;
+                    edge_capacity[edge_index(j, i)] = bw[k] * toByte;
                     k++;
                 }
             }
@@ -300,20 +832,19 @@ public:
         // server connection capacity
         for (int i = 0; i < srv_qty; i++)
         {
-            for (int j = srv_qty; j < srv_qty + sw_qty; j++)
+            for (int j : neighbours(i))
             {
-                link_capacity[i][j] = e[i][j] * sc_bw * toByte;
-                link_capacity[j][i] = e[j][i] * sc_bw * toByte;
+                edge_capacity[edge_index(i, j)] = sc_bw * toByte;
+                edge_capacity[edge_index(j, i)] = sc_bw * toByte;
             }
         }
 
         // client connection capacity
-        for (int i = srv_qty + sw_qty; i < vertex_qty; i++)
+        for (auto &attachments : client_attachments)
         {
-            for (auto j : ClientSideOFSWs)
+            for (auto &access_capacity : attachments.access_capacity)
             {
-                link_capacity[i][j] = sc_bw * toByte;
-                link_capacity[j][i] = sc_bw * toByte;
+                access_capacity = sc_bw * toByte;
             }
             /*
             for (int j = srv_qty; j < srv_qty + sw_qty; j++)
@@ -364,85 +895,214 @@ public:
          */
     }
 
-    void set_b_ij()
+    void set_link_capacity(const Topology_Description &topology)
     {
-        for (int i = 0; i < b_ij.size(); i++)
+        for (auto &link : topology.links)
+        {
+            edge_capacity[edge_index(link[0], link[1])] = link[2];
+            edge_capacity[edge_index(link[1], link[0])] = link[2];
+        }
+        for (auto &attachments : client_attachments)
         {
-            for (int j = 0; j < b_ij.size(); j++)
+            for (auto &access_capacity : attachments.access_capacity)
             {
-
-                b_ij[i][j] = link_capacity[i][j];
-                // cout << (b_ij[i][j] * 8) / (1000 * 1000) << "\t";
+                access_capacity = topology.access_capacity;
             }
-            // cout << "\n";
         }
+    }
+
+    void set_b_ij()
+    {
+        edge_b = edge_capacity; // avaiable bw of each edge starts from its link capacity
     } // end of set_bij()
 
-    // sets client side sws connections
-    void set_C_OF_SWs_Connections()
+    // Topology update API. Capacity changes and link failures/restorations are applied to the edge arrays and recorded
+    // as deltas, so a live multiserver LP can be patched (see Multiserver_LP::apply_deltas) instead of being rebuilt.
+    // Failed links stay in the CSR adjacency with zero capacity, which keeps the LP structure unchanged.
+    // Other threads don't touch the edge arrays, they post Link_Events. The solve stage applies them with apply_link_events(),
+    // so set_link_capacity(), fail_link() and restore_link() run only on the solve thread.
+    struct Topo_Delta
     {
-        // cout << "-----------------------------------------set_C_OF_SWs_Connections\n";
+        int i; // e index of edge's source
+        int j; // e index of edge's destination
+    };
+    std::vector<Topo_Delta> pending_deltas;
+    std::map<int, int> failed_links; // CSR edge index of failed links -> capacity before failure
 
-        for (int i : ClientSideOFSWs)
+    struct Link_Event
+    {
+        enum Kind
         {
-            for (int j : OF_SWs)
-            {
-                auto itr = ClientSideOFSWs.find(j); // if the neighboor is not server site sw
-                if (e[i][j] == 1 && itr == ClientSideOFSWs.end())
-                {
-                    // cout << "set_C_OF_SWs_Connections: " << i << "--->" << j << ", ";
-
-                    C_OF_SWs_Connections[i].emplace(j);
-                }
-            }
-            // cout << "\n";
+            capacity_change,
+            failure,
+            restoration
+        };
+        Kind kind;
+        int i;
+        int j;
+        int capacity; // new capacity of capacity_change
+        std::chrono::steady_clock::time_point posted;
+    };
+    std::mutex link_event_mutex;
+    std::condition_variable link_event_posted;
+    std::vector<Link_Event> posted_link_events; // guarded by link_event_mutex
+
+    // thread safe, the event is applied by the solve stage as soon as it waits for events
+    void post_link_event(Link_Event event)
+    {
+        event.posted = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(link_event_mutex);
+            posted_link_events.push_back(event);
         }
+        link_event_posted.notify_one();
     }
 
-    // sets Server_OF_SWs_Connections
-    void set_Server_OF_SWs_Connections()
+    // waits until a link event is posted or until, true if there are events to apply
+    bool wait_link_event(std::chrono::steady_clock::time_point until)
     {
-        // cout << "-----------------------------------------Server_OF_SWs_Connections: ";
-        for (int i : ServerSideOFSWs)
-        {
+        std::unique_lock<std::mutex> lock(link_event_mutex);
+        return link_event_posted.wait_until(lock, until, [this]
+                                            { return !posted_link_events.empty(); });
+    }
 
-            for (int j : OF_SWs)
+    // applies posted events to the edge arrays and records their deltas, returns the oldest event's post time or nullopt if none.
+    // Events of unknown links are logged and skipped, the solve stage goes on with the others.
+    std::optional<std::chrono::steady_clock::time_point> apply_link_events()
+    {
+        std::vector<Link_Event> events;
+        {
+            std::lock_guard<std::mutex> lock(link_event_mutex);
+            events.swap(posted_link_events);
+        }
+        if (events.empty())
+            return std::nullopt;
+        for (auto &event : events)
+        {
+            if (!has_link(event.i, event.j))
             {
-                // auto itr = find( ServerSideOFSWs.begin(), ServerSideOFSWs.end(), j );
-                auto itr = ServerSideOFSWs.find(j); // if the neighboor is not server site sw
-                if (e[i][j] == 1 && itr == ServerSideOFSWs.end())
-                {
-                    // cout << i << "--->" << j << ", ";
-                    Server_OF_SWs_Connections[i].emplace(j);
-                }
+                cout << "link event skipped, no link between " << event.i << " and " << event.j << "\n";
+                continue;
             }
-            // cout << "\n";
-            for (int k : ClientSideOFSWs)
+            if (event.kind == Link_Event::capacity_change && event.capacity < 0)
             {
-                auto itr = ServerSideOFSWs.find(k); // if the neighboor is not server site sw
-                if (e[i][k] == 1 && itr == ServerSideOFSWs.end())
-                {
-                    // cout << i << "--->" << k << ", ";
-                    Server_OF_SWs_Connections[i].emplace(k);
-                }
+                cout << "link event skipped, negative capacity " << event.capacity << " of link " << event.i << "-" << event.j << "\n";
+                continue;
             }
+            if (event.kind == Link_Event::capacity_change)
+                set_link_capacity(event.i, event.j, event.capacity);
+            else if (event.kind == Link_Event::failure)
+                fail_link(event.i, event.j);
+            else
+                restore_link(event.i, event.j);
         }
+        return events.front().posted;
     }
 
-    void set_ServerSideOFSWs_Connected_Servers()
+    // sets capacity (and avaiable bw) of i-j link in both directions
+    void set_link_capacity(int i, int j, int capacity)
     {
-        for (int i : ServerSideOFSWs)
+        for (auto edge : {std::make_pair(i, j), std::make_pair(j, i)})
         {
-            for (int j = 0; j < srv_qty; j++)
+            int k = edge_index(edge.first, edge.second);
+            if (k < 0)
+                throw std::runtime_error("no link between " + std::to_string(i) + " and " + std::to_string(j));
+            auto failed_itr = failed_links.find(k);
+            if (failed_itr != failed_links.end())
             {
-                if (e[i][j] == 1)
-                {
-                    ServerSideOFSWs_Connected_Servers[i].emplace(j);
-                }
+                failed_itr->second = capacity; // applied when the link is restored
+                continue;
             }
+            edge_capacity[k] = capacity;
+            edge_b[k] = capacity;
+            pending_deltas.push_back({edge.first, edge.second});
+        }
+    }
+
+    void fail_link(int i, int j)
+    {
+        for (auto edge : {std::make_pair(i, j), std::make_pair(j, i)})
+        {
+            int k = edge_index(edge.first, edge.second);
+            if (k < 0 || failed_links.count(k))
+                continue;
+            failed_links[k] = edge_capacity[k];
+            edge_capacity[k] = 0;
+            edge_b[k] = 0;
+            pending_deltas.push_back({edge.first, edge.second});
+        }
+    }
+
+    void restore_link(int i, int j)
+    {
+        for (auto edge : {std::make_pair(i, j), std::make_pair(j, i)})
+        {
+            int k = edge_index(edge.first, edge.second);
+            auto failed_itr = failed_links.find(k);
+            if (k < 0 || failed_itr == failed_links.end())
+                continue;
+            edge_capacity[k] = failed_itr->second;
+            edge_b[k] = failed_itr->second;
+            failed_links.erase(failed_itr);
+            pending_deltas.push_back({edge.first, edge.second});
         }
     }
 
+    // returns recorded deltas and clears them
+    std::vector<Topo_Delta> take_deltas()
+    {
+        std::vector<Topo_Delta> deltas;
+        deltas.swap(pending_deltas);
+        return deltas;
+    }
+
+    // builds role bitsets, OF_SWs, OF_SWs_No_SSSWs and every connection list of the core graph in one pass over the CSR adjacency
+    void set_flat_indexes()
+    {
+        server_side_sw.assign(core_qty, false);
+        client_side_sw.assign(core_qty, false);
+        for (int i : ServerSideOFSWs)
+        {
+            server_side_sw[i] = true;
+        }
+        for (int i : ClientSideOFSWs)
+        {
+            client_side_sw[i] = true;
+        }
+
+        for (int i = 0; i < core_qty; i++)
+        {
+            bool is_of_sw = i >= srv_qty && !client_side_sw[i]; // all sws but Y
+            bool is_no_sssw = is_of_sw && !server_side_sw[i];   // all sws but X and Y
+            if (is_of_sw)
+                OF_SWs.emplace_back(i);
+            if (is_no_sssw)
+                OF_SWs_No_SSSWs.emplace_back(i);
+
+            for (int j : neighbours(i))
+            {
+                bool j_is_sw = j >= srv_qty;
+                if (is_of_sw)
+                    OF_SWs_Connections.add(j);
+                if (is_no_sssw && j_is_sw)
+                    OF_SWs_No_SSSWs_Connections.add(j);
+                if (client_side_sw[i] && j_is_sw && !client_side_sw[j]) // if the neighboor is not client side sw
+                    C_OF_SWs_Connections.add(j);
+                if (server_side_sw[i] && j_is_sw && !server_side_sw[j]) // if the neighboor is not server side sw
+                    Server_OF_SWs_Connections.add(j);
+                if (server_side_sw[i] && !j_is_sw)
+                    ServerSideOFSWs_Connected_Servers.add(j);
+                if (i < srv_qty && j_is_sw && srv_con_sws_e_index2.count(i) == 0)
+                    srv_con_sws_e_index2[i] = j;
+            }
+            OF_SWs_Connections.end_row();
+            OF_SWs_No_SSSWs_Connections.end_row();
+            C_OF_SWs_Connections.end_row();
+            Server_OF_SWs_Connections.end_row();
+            ServerSideOFSWs_Connected_Servers.end_row();
+        }
+    } // end of set_flat_indexes()
+
     /*
     void set_C_N_i_client_ofsw()
     {
@@ -450,7 +1110,7 @@ public:
         {                                                       //each OFSWs will be walked through
             for (int j = srv_qty + sw_qty; j < vertex_qty; j++) //All clients
             {                                                   //each client traversed
-                if (e[i][j] == 1)
+                if (has_edge(i, j))
                 { //if a ofsw is connected to a client that ofsw's index i is inserted to set C
                     C.emplace(i);
                     N_i[i].emplace(j);
@@ -460,82 +1120,10 @@ public:
         }
     }
 */
-    void set_OF_SWs()
-    {
-        for (int i = srv_qty; i < srv_qty + sw_qty; i++)
-        { // each OFSWs will be walked through
-            for (int j : ClientSideOFSWs)
-            { // client side OFSWs
-                if (i == j)
-                {
-                    i_j_equal = true;
-                    break;
-                }
-            }
-            if (!i_j_equal)
-            {
-                OF_SWs.emplace_back(i);
-            }
-            i_j_equal = false;
-        }
-
-        // All OF SWs except client side OF SWs
-        for (int i = 0; i < srv_qty + sw_qty; i++)
-        {
-            for (int j : OF_SWs)
-            {
-                if (e[i][j] == 1)
-                {
-                    OF_SWs_Connections[j].emplace(i);
-                }
-            }
-        }
-    } // end of set_OF_SWs()
-
-    // All sws except client and server site sws.
-    void set_OF_SWs_No_SSSWs()
-    {
-        // All OF SWs except client end server side OF SWs
-        for (int i : OF_SWs)
-        {
-            auto itr = ServerSideOFSWs.find(i);
-            if (itr == ServerSideOFSWs.end())
-                OF_SWs_No_SSSWs.emplace_back(i);
-        }
-        // All OF SWs except client side and server side OF SWs
-        for (int i : OF_SWs_No_SSSWs) // first switch index in e starts from srv_qty
-        {
-            for (int j : OF_SWs)
-            {
-                if (e[i][j] == 1)
-                {
-                    OF_SWs_No_SSSWs_Connections[i].emplace(j);
-                }
-            }
-
-            for (int j : ClientSideOFSWs)
-            {
-                if (e[i][j] == 1)
-                {
-                    OF_SWs_No_SSSWs_Connections[i].emplace(j);
-                }
-            }
-        }
-        /*
-        cout << "OF_SWs_No_SSSWs_Connections\n";
-        for (auto i : OF_SWs_No_SSSWs_Connections)
-        {
-            for (int j : i.second)
-            {
-                cout << i.first << "-->" << j << "\n";
-            }
-        }
-        */
-    } // end of set_OF_SWs_No_SSSWs()
-
-    /*
-    //Client side OFSWs and their connected clients print
-    for (auto &i : N_i)
+
+    /*
+    //Client side OFSWs and their connected clients print
+    for (auto &i : N_i)
     {
         cout << i.first << " (client side ofsw) "
              << ": ";
@@ -565,784 +1153,3424 @@ public:
 */
 }; // end of class Net_Topo
 
-// obtains video file names and sizes from HTTP Media Server repository/directory and saves them in files_sizes map.
-void get_video_file_sizes(unordered_map<string, double> &files_sizes)
+// Reads a link event file, one event per line, '#' starts a comment. Links are given by e indexes of their ends:
+//   <ms after start> fail <i> <j>
+//   <ms after start> restore <i> <j>
+//   <ms after start> capacity <i> <j> <capacity>
+// Events are checked against net_topo, a link it doesn't have or a negative capacity fails the whole file.
+std::vector<std::pair<int, Net_Topo::Link_Event>> read_link_events(const std::string &path, const Net_Topo &net_topo)
 {
-    std::string path = "./mediaServer/BBB/I/segs/1080p";
-    // std::string path = "./mediaServer/ED/I/segs/1080p";
-
-    for (const auto &entry : fs::directory_iterator(path))
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("can't open link event file " + path);
+    std::vector<std::pair<int, Net_Topo::Link_Event>> events;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line))
     {
-        files_sizes.insert(std::make_pair(entry.path().filename(), fs::file_size(entry.path())));
-    }
-    /*
-    for (auto &e : files_sizes){
-    std::cout << e.first << " : "<< e.second << std::endl;
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        int at_ms;
+        std::string keyword;
+        if (!(words >> at_ms))
+            continue;
+        Net_Topo::Link_Event event = {};
+        bool parsed = words >> keyword >> event.i >> event.j && (keyword != "capacity" || words >> event.capacity);
+        if (parsed && keyword == "fail")
+            event.kind = Net_Topo::Link_Event::failure;
+        else if (parsed && keyword == "restore")
+            event.kind = Net_Topo::Link_Event::restoration;
+        else if (parsed && keyword == "capacity")
+            event.kind = Net_Topo::Link_Event::capacity_change;
+        else
+            throw std::runtime_error(path + ":" + std::to_string(line_no) + ": can't parse \"" + line + "\"");
+        if (!net_topo.has_link(event.i, event.j))
+            throw std::runtime_error(path + ":" + std::to_string(line_no) + ": no link between " + std::to_string(event.i) + " and " + std::to_string(event.j));
+        if (event.capacity < 0)
+            throw std::runtime_error(path + ":" + std::to_string(line_no) + ": negative capacity " + std::to_string(event.capacity));
+        events.emplace_back(at_ms, event);
     }
-    */
+    std::stable_sort(events.begin(), events.end(), [](const std::pair<int, Net_Topo::Link_Event> &a, const std::pair<int, Net_Topo::Link_Event> &b)
+                     { return a.first < b.first; });
+    return events;
 }
 
-void set_b_bar_cl(vector<vector<double>> &b_bar_cl, int requests_qty, int m_c, unordered_map<string, double> &files_sizes, double teta, int seg_index)
+// Segment size catalog. build_segment_catalog() scans the media server's directories once and writes a binary file, optimizer maps it
+// and looks up sizes by (video, segment, layer) index, with no file names or hashing at each cycle. File layout:
+//   Catalog_Header, Catalog_Video[video_qty], uint32_t sizes[] (bytes of each segment's layers, video by video, segment major)
+struct Catalog_Header
 {
-    double toMegabit = 8.0 / (1000 * 1000);
-    for (int i = 0; i < requests_qty; i++)
-    {
-        // each layer size (as byte) is recorded to b_bar_cl for client c's segment request
+    char magic[8];
+    uint32_t video_qty;
+    uint32_t layer_qty;
+};
 
-        string base_file_name = "BBB-I-1080p.seg" + std::to_string(seg_index) + "-L0.svc";
-        base_file_name = base_file_name.substr(0, base_file_name.rfind(".svc") - 1);
-        string file_name;
-        const int http_header_size = 500; // Ortalama header size 500 Byte olarak belirlenmiştir. İHTİYAÇ DUYULURSA DAHA KESİN BİR DEĞER GİRİLEBİLİR.
-        for (int j = 0; j < m_c; j++)
-        {
-            // layer of requested segment's file name is obtained
-            // each layer size of segment is recorded and converted to bandwith requirement (Byte per second) diving file size to 2(teta)
-            file_name = base_file_name + std::to_string(j) + ".svc";
-            b_bar_cl[i].emplace_back((/*Network Overhead*/ (1.054 * (files_sizes[file_name] + http_header_size)) * toMegabit) / teta); // Required BW to download this layer on time - Byte per second.
-            // cout << "file_name: " << file_name << " --- " << "Required BW (Mb): " << b_bar_cl[i][j] << "\n";
-        }
-    }
-} // end of update_b_bar_c_l func
+struct Catalog_Video
+{
+    char name[32];
+    uint32_t segment_qty;
+    uint32_t first_size; // index of the video's first size in sizes[]
+};
 
-int total_layer_qty(vector2d &b_bar_cl, int requests_qty)
+void write_segment_catalog(const std::string &catalog_path, const std::vector<Catalog_Video> &videos, uint32_t layer_qty, const std::vector<uint32_t> &sizes);
+
+typedef std::map<std::pair<int, int>, uint32_t> Segment_Sizes; // (segment, layer) -> bytes
+
+// sets videos' first_size and lays video_sizes out in sizes[], missing layers have size 0
+void pack_segment_catalog(std::vector<Catalog_Video> &videos, const std::vector<Segment_Sizes> &video_sizes, uint32_t layer_qty, std::vector<uint32_t> &sizes)
 {
-    int total_layer_qty = 0;
-    for (int i = 0; i < requests_qty; i++)
+    sizes.clear();
+    for (size_t v = 0; v < videos.size(); v++)
     {
-        total_layer_qty += b_bar_cl[i].size();
+        videos[v].first_size = sizes.size();
+        sizes.resize(sizes.size() + (size_t)videos[v].segment_qty * layer_qty, 0);
+        for (auto &size : video_sizes[v])
+            sizes[videos[v].first_size + size.first.first * layer_qty + size.first.second] = size.second;
     }
-    return total_layer_qty;
 }
-// multiserver(multiserverEnv, net_topo, b_bar_cl, m_c, r_sc_sol, r_sc_gamma_sol, gamma_ij_sol, provided_rate_for_c);
 
-void multiserver(IloEnv multiserverEnv, Net_Topo &net_topo, vector<vector<double>> &b_bar_cl, int m_c, IloNumArray2 &r_sc_sol, IloNumArray2 &r_sc_gamma_sol,
-                 IloNumArray2 &gamma_ij_sol, vector<double> &provided_rate_for_c, IloNumArray4 &f_sc_ij_sol)
+// segment and layer of a <video>-I-1080p.seg<N>-L<l>.svc file name, false if it isn't a segment file
+bool parse_segment_file(const std::string &file_name, int &segment, int &layer)
 {
-    IloModel model(multiserverEnv);
-    int server_site_sws_qty = net_topo.ServerSideOFSWs.size();
-    int client_site_sws_qty = net_topo.ClientSideOFSWs.size();
-    IloNumVarArray2 r_sc(multiserverEnv, server_site_sws_qty);       // variables to get bw rate server site sws to client site sws
-    IloNumVarArray2 r_sc_gamma(multiserverEnv, server_site_sws_qty); // variables to get incrase bw rate server site sws to client site sws to get robustness against fractional reduction since layers bw need and bw fraction may not be same
-    // std::map<int, double> req_max_rates_from_cssws;               // keeps required max data rate for clients site sws
-    IloNumVarArray4 f_sc_ij(multiserverEnv, server_site_sws_qty); // variables to get bw rate on all edges for sssws (server site sws) and cssws (client site sws)
-    IloNumVarArray2 gamma_ij(multiserverEnv, (net_topo.srv_qty + net_topo.sw_qty));
+    size_t seg_pos = file_name.rfind(".seg");
+    return seg_pos != std::string::npos && sscanf(file_name.c_str() + seg_pos, ".seg%d-L%d.svc", &segment, &layer) == 2 && segment >= 0 && layer >= 0;
+}
 
-    /*
-    // calculating cssw's required max data rates
-    for (int c = 0; c < net_topo.requests_qty; c++)
+// Videos are the directories of media_root, segments are in <video>/I/segs/1080p as <video>-I-1080p.seg<N>-L<l>.svc
+void build_segment_catalog(const std::string &media_root, const std::string &catalog_path)
+{
+    std::vector<Catalog_Video> videos;
+    std::vector<Segment_Sizes> video_sizes;
+    uint32_t layer_qty = 0;
+    std::vector<fs::path> video_dirs;
+    for (const auto &entry : fs::directory_iterator(media_root))
+        if (entry.is_directory())
+            video_dirs.emplace_back(entry.path());
+    std::sort(video_dirs.begin(), video_dirs.end());
+    for (auto &video_dir : video_dirs)
     {
-        req_max_rates_from_cssws[net_topo.sw_qty] = 0;
+        fs::path segs = video_dir / "I" / "segs" / "1080p";
+        if (!fs::is_directory(segs))
+            continue;
+        Catalog_Video video = {};
+        std::string name = video_dir.filename().string();
+        if (name.size() >= sizeof(video.name))
+            throw std::runtime_error("video name " + name + " is too long for the catalog");
+        std::memcpy(video.name, name.c_str(), name.size());
+        Segment_Sizes sizes;
+        for (const auto &entry : fs::directory_iterator(segs))
+        {
+            int segment, layer;
+            if (!parse_segment_file(entry.path().filename().string(), segment, layer))
+                continue;
+            sizes[{segment, layer}] = fs::file_size(entry.path());
+            video.segment_qty = std::max<uint32_t>(video.segment_qty, segment + 1);
+            layer_qty = std::max<uint32_t>(layer_qty, layer + 1);
+        }
+        videos.emplace_back(video);
+        video_sizes.emplace_back(std::move(sizes));
     }
 
-    for (int c = 0; c < net_topo.requests_qty; c++)
+    std::vector<uint32_t> sizes;
+    pack_segment_catalog(videos, video_sizes, layer_qty, sizes);
+    write_segment_catalog(catalog_path, videos, layer_qty, sizes);
+}
+
+// videos' first_size are indexes in sizes
+void write_segment_catalog(const std::string &catalog_path, const std::vector<Catalog_Video> &videos, uint32_t layer_qty, const std::vector<uint32_t> &sizes)
+{
+    Catalog_Header header = {};
+    std::memcpy(header.magic, "FROGCAT1", 8);
+    header.video_qty = videos.size();
+    header.layer_qty = layer_qty;
+    std::ofstream out(catalog_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(videos.data()), videos.size() * sizeof(Catalog_Video));
+    out.write(reinterpret_cast<const char *>(sizes.data()), sizes.size() * sizeof(uint32_t));
+    if (!out)
+        throw std::runtime_error("can't write segment catalog " + catalog_path);
+    cout << "segment catalog " << catalog_path << ": " << videos.size() << " videos, " << layer_qty << " layers, " << sizes.size() << " sizes\n";
+}
+
+// Read only mapping of a catalog file built by build_segment_catalog()
+class Segment_Catalog
+{
+public:
+    explicit Segment_Catalog(const std::string &path)
     {
-        int client_c_rate = 0;
-        for (int l = 0; l < m_c; l++)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Catalog_Header))
         {
-            client_c_rate += b_bar_cl[c][l]; // requested files from c * file size / TETA
+            if (fd >= 0)
+                ::close(fd);
+            throw std::runtime_error("can't open segment catalog " + path);
         }
-        req_max_rates_from_cssws[net_topo.sw_qty] += client_c_rate;
-    }
-    */
-    /*
-    cout << "************************Required bit rate: ";
-    for (auto cssw : req_max_rates_from_cssws)
-    {
-        cout << cssw.first << " --- " << cssw.second << "\n";
-    }
-    */
-    // object function for r_sc
-    IloExpr exp_r_sc_obj(multiserverEnv);
-    // r_sc variables are declared & initilized
-    for (int s = 0; s < server_site_sws_qty; s++)
-    {
-        r_sc[s] = IloNumVarArray(multiserverEnv, client_site_sws_qty);
-        r_sc_gamma[s] = IloNumVarArray(multiserverEnv, client_site_sws_qty);
-        for (int c = 0; c < client_site_sws_qty; c++)
+        mapped_bytes = st.st_size;
+        data = mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("can't map segment catalog " + path);
+        header = static_cast<const Catalog_Header *>(data);
+        // the video table is checked to be in the mapping before it's read, then the sizes its videos refer to
+        size_t sizes_offset = sizeof(Catalog_Header) + (size_t)header->video_qty * sizeof(Catalog_Video);
+        bool valid = std::memcmp(header->magic, "FROGCAT1", 8) == 0 && sizes_offset <= mapped_bytes;
+        videos = reinterpret_cast<const Catalog_Video *>(header + 1);
+        sizes = reinterpret_cast<const uint32_t *>((const char *)data + sizes_offset);
+        size_t size_qty = 0;
+        for (uint32_t v = 0; valid && v < header->video_qty; v++)
+            size_qty = std::max<size_t>(size_qty, videos[v].first_size + (size_t)videos[v].segment_qty * header->layer_qty);
+        if (!valid || size_qty > (mapped_bytes - sizes_offset) / sizeof(uint32_t))
         {
-            r_sc[s][c] = IloNumVar(multiserverEnv, 0, IloInfinity);
-            r_sc_gamma[s][c] = IloNumVar(multiserverEnv, 0, IloInfinity);
-            exp_r_sc_obj += r_sc[s][c]; // + r_sc_gamma[s][c];
+            munmap(data, mapped_bytes);
+            throw std::runtime_error(path + " isn't a segment catalog");
         }
     }
-    /*
-    // BW upper bound according to y
-    //  constants for r_sc --- r_sc[0][0] + r_sc[1][0] <= max_rate_of_c[0]
-    auto max_rate_of_c = req_max_rates_from_cssws.begin();
-    for (int c = 0; c < client_site_sws_qty; c++)
+    Segment_Catalog(const Segment_Catalog &) = delete;
+    ~Segment_Catalog() { munmap(data, mapped_bytes); }
+
+    // index of the video, -1 if it isn't in the catalog. Called once when a video is requested, not per cycle.
+    int video(const std::string &name) const
     {
-        IloExpr exp_r_sc_const(multiserverEnv);
-        for (int s = 0; s < server_site_sws_qty; s++)
-        {
-            exp_r_sc_const += r_sc[s][c];
-        }
-        // cout << "*******************++++++++++++++++++++++++++*************max_rate_of_c: " << max_rate_of_c->first << ": " << max_rate_of_c->second << "\n";
-        model.add(exp_r_sc_const <= max_rate_of_c->second);
-        exp_r_sc_const.end();
-        max_rate_of_c++;
+        for (uint32_t v = 0; v < header->video_qty; v++)
+            if (name == videos[v].name)
+                return v;
+        return -1;
     }
-    */
-    //The constraint, upper bound according to x's connections
-    for (auto x : net_topo.Server_OF_SWs_Connections)
+    int video_qty() const { return header->video_qty; }
+    const char *video_name(int video) const { return videos[video].name; }
+    int segment_qty(int video) const { return videos[video].segment_qty; }
+    int layer_qty() const { return header->layer_qty; }
+
+    // bytes of the layer, 0 if the layer or segment isn't in the catalog
+    double size(int video, int segment, int layer) const
     {
-        double bit_rate_of_x = 0.0;
-        // long double bit_rate_of_x = 0.0;
-        for (auto j : x.second)
-        {
-            bit_rate_of_x += net_topo.b_ij[x.first][j];
-        }
-        IloExpr exp_r_sc_const2(multiserverEnv);
-        for (int y = 0; y < client_site_sws_qty; y++)
-        {
-            exp_r_sc_const2 += r_sc[x.first - net_topo.srv_qty][y];
-        }
-        model.add(exp_r_sc_const2 <= bit_rate_of_x);
-        exp_r_sc_const2.end();
+        const Catalog_Video &v = videos[video];
+        if ((uint32_t)segment >= v.segment_qty || (uint32_t)layer >= header->layer_qty)
+            return 0;
+        return sizes[v.first_size + (size_t)segment * header->layer_qty + layer];
     }
 
-    /*
-    for (int s = 0; s < server_site_sws_qty; s++)
+private:
+    void *data;
+    size_t mapped_bytes;
+    const Catalog_Header *header;
+    const Catalog_Video *videos;
+    const uint32_t *sizes;
+};
+
+// Keeps the segment catalog up to date while renditions land in the media server. A thread follows media_root with inotify and
+// adds each closed or moved in segment file to its own index, one file at a time, no directory rescans. When a burst of events
+// is over it writes the catalog next to the old one, renames it over and maps it as a new snapshot, then swaps the snapshot
+// pointer. Readers take the pointer once per cycle with snapshot() and keep their mapping until they drop it, so a catalog
+// update never waits for a cycle and a cycle never waits for an update. Videos keep their index, new videos are appended.
+class Catalog_Watcher
+{
+public:
+    Catalog_Watcher(const std::string &media_root, const std::string &catalog_path)
+        : media_root(media_root), catalog_path(catalog_path)
     {
-        for (int c = 0; c < client_site_sws_qty; c++)
+        current = std::make_shared<const Segment_Catalog>(catalog_path);
+        const Segment_Catalog &catalog = *current;
+        layer_qty = catalog.layer_qty();
+        for (int v = 0; v < catalog.video_qty(); v++)
         {
-            model.add(r_sc_gamma[s][c] <= r_sc[s][c]/20.0);
+            Catalog_Video video = {};
+            std::memcpy(video.name, catalog.video_name(v), sizeof(video.name));
+            video.segment_qty = catalog.segment_qty(v);
+            videos.emplace_back(video);
+            video_of_name[video.name] = v;
+            Segment_Sizes sizes;
+            for (int i = 0; i < catalog.segment_qty(v); i++)
+                for (int l = 0; l < catalog.layer_qty(); l++)
+                    if (catalog.size(v, i, l) > 0)
+                        sizes[{i, l}] = catalog.size(v, i, l);
+            video_sizes.emplace_back(std::move(sizes));
         }
+
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0 || !fs::is_directory(media_root))
+        {
+            cout << "segment catalog " << catalog_path << " isn't watched, " << media_root << " can't be followed\n";
+            return;
+        }
+        watch_tree(media_root);
+        if (add_tree(media_root)) // files written after the catalog was built, before the watches were set
+            publish();
+        watcher = std::thread(&Catalog_Watcher::run, this);
     }
-    */
-    for (int i = 0; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+    Catalog_Watcher(const Catalog_Watcher &) = delete;
+    ~Catalog_Watcher()
     {
-        gamma_ij[i] = IloNumVarArray(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty));
-        for (int j = 0; j < (net_topo.sw_qty + net_topo.srv_qty); j++)
         {
-            gamma_ij[i][j] = IloNumVar(multiserverEnv, 0, net_topo.link_capacity[i][j] / (double)10.0); // If there is enough capacity, it tries to keep 10% of the link capacity free against burst usage
-            if (net_topo.e[i][j] == 0)
-            {
-                gamma_ij[i][j].setBounds(0, 0);
-            }
+            std::unique_lock<std::mutex> lock(epoch_mutex);
+            stopping = true;
         }
+        epoch_published.notify_all();
+        if (watcher.joinable())
+            watcher.join();
+        if (inotify_fd >= 0)
+            ::close(inotify_fd);
     }
 
-    // No need for servers
-    for (int i = 0; i < net_topo.srv_qty; i++)
+    // catalog the cycle reads from, unchanged for as long as the caller holds it
+    std::shared_ptr<const Segment_Catalog> snapshot() const { return std::atomic_load(&current); }
+    int epoch() const { return published_epoch.load(std::memory_order_relaxed); }
+    bool watching() const { return watcher.joinable(); }
+
+    // waits until a catalog newer than seen_epoch is published, the watcher stops or deadline. true if there's a newer catalog
+    bool wait_epoch(int seen_epoch, std::chrono::steady_clock::time_point deadline)
     {
-        for (int j = 0; j < (net_topo.sw_qty + net_topo.srv_qty); j++)
-        {
-            gamma_ij[i][j].setBounds(0, 0);
-        }
+        std::unique_lock<std::mutex> lock(epoch_mutex);
+        epoch_published.wait_until(lock, deadline, [&]
+                                   { return published_epoch > seen_epoch || stopping; });
+        return published_epoch > seen_epoch;
     }
 
-    // f_sc_ij and f_sc_gamma_ij variables are declared & initilized
-    for (int s = 0; s < server_site_sws_qty; s++)
+private:
+    int const quiet_ms = 200; // a burst of events is over after this long without one
+
+    void run()
     {
-        f_sc_ij[s] = IloNumVarArray3(multiserverEnv, client_site_sws_qty);
-        // f_sc_gamma_ij[s] = IloNumVarArray3(multiserverEnv, client_site_sws_qty);
-        for (int c = 0; c < client_site_sws_qty; c++)
+        std::vector<char> buffer(64 * 1024);
+        bool changed = false;
+        while (!stopping)
         {
-            f_sc_ij[s][c] = IloNumVarArray2(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty));
-            // f_sc_gamma_ij[s][c] = IloNumVarArray2(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty));
-            for (int i = 0; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+            pollfd pfd = {inotify_fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, changed ? quiet_ms : 100);
+            if (ready < 0 && errno != EINTR)
+                break;
+            if (ready <= 0)
             {
-                f_sc_ij[s][c][i] = IloNumVarArray(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty), 0, IloInfinity); // defining vertex array's 2nd dimention which contain cplex variable array
-                // f_sc_gamma_ij[s][c][i] = IloNumVarArray(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty), 0, IloInfinity); // defining vertex array's 2nd dimention which contain cplex variable array
-                for (int j = 0; j < (net_topo.sw_qty + net_topo.srv_qty); j++)
+                if (changed)
+                    publish();
+                changed = false;
+                continue;
+            }
+            ssize_t length;
+            while ((length = read(inotify_fd, buffer.data(), buffer.size())) > 0)
+                for (char *p = buffer.data(); p < buffer.data() + length;)
                 {
-                    // cout << "init scij: " << s << c << i << j << "\n";
-                    if (net_topo.e[i][j] == 0)
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+                    p += sizeof(inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW) // events were dropped, the tree is indexed again
                     {
-                        f_sc_ij[s][c][i][j].setBounds(0, 0);
+                        watch_tree(media_root);
+                        changed |= add_tree(media_root);
+                        continue;
                     }
-                    else
+                    auto dir = watched_dirs.find(event->wd);
+                    if (dir == watched_dirs.end() || event->len == 0)
+                        continue;
+                    fs::path path = dir->second / event->name;
+                    if (event->mask & IN_ISDIR)
                     {
-                        // f_sc_gamma_ij[s][c][i][j] = IloNumVar(multiserverEnv, 0, net_topo.link_capacity[i][j] / 10.0);
+                        watch_tree(path);
+                        changed |= add_tree(path); // files written before its watch was set
                     }
+                    else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) // a created file is indexed once it's closed
+                        changed |= add_file(path);
                 }
-            }
-            // No need servers
-            for (int i = 0; i < net_topo.srv_qty; i++)
-            {
-                for (int j = 0; j < (net_topo.sw_qty + net_topo.srv_qty); j++)
-                {
-                    f_sc_ij[s][c][i][j].setBounds(0, 0);
-                    // f_sc_gamma_ij[s][c][i][j].setBounds(0, 0);
-                }
-            }
         }
     }
 
-    // IloArray<IloArray<IloExprArray>> f_sc_ij_const_1_ExprArr(multiserverEnv, server_site_sws_qty);
-    //  f_sc_ij constraint 1 --- if i Element of SSSWs
+    void watch_tree(const fs::path &dir)
+    {
+        std::error_code error;
+        int wd = inotify_add_watch(inotify_fd, dir.c_str(), IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR);
+        if (wd < 0)
+            return;
+        watched_dirs[wd] = dir;
+        for (const auto &entry : fs::directory_iterator(dir, error))
+            if (entry.is_directory(error))
+                watch_tree(entry.path());
+    }
 
-    for (int s = 0; s < server_site_sws_qty; s++)
+    bool add_tree(const fs::path &dir)
     {
-        // f_sc_ij_const_1_ExprArr[s] =  IloArray<IloExprArray>(multiserverEnv, client_site_sws_qty);
-        for (int c = 0; c < client_site_sws_qty; c++)
-        {
-            IloExprArray f_sc_ij_const_1_ExprArr(multiserverEnv, 2);
-            f_sc_ij_const_1_ExprArr[0] = IloExpr(multiserverEnv);
-            f_sc_ij_const_1_ExprArr[1] = IloExpr(multiserverEnv);
+        std::error_code error;
+        bool changed = false;
+        for (auto entry = fs::recursive_directory_iterator(dir, error); !error && entry != fs::recursive_directory_iterator(); entry.increment(error))
+            if (entry->is_regular_file(error))
+                changed |= add_file(entry->path());
+        return changed;
+    }
 
-            auto i = net_topo.Server_OF_SWs_Connections.find(s + net_topo.srv_qty);
+    // path is media_root/<video>/I/segs/1080p/<segment file>, true if the index changed
+    bool add_file(const fs::path &path)
+    {
+        int segment, layer;
+        fs::path segs = path.parent_path();
+        if (!parse_segment_file(path.filename().string(), segment, layer) || segs.filename() != "1080p" || segs.parent_path().filename() != "segs" ||
+            segs.parent_path().parent_path().filename() != "I")
+            return false;
+        std::error_code error;
+        uint32_t size = fs::file_size(path, error);
+        if (error)
+            return false;
+        std::string name = segs.parent_path().parent_path().parent_path().filename().string();
+        auto found = video_of_name.find(name);
+        if (found == video_of_name.end())
+        {
+            Catalog_Video video = {};
+            if (name.size() >= sizeof(video.name))
+                return false;
+            std::memcpy(video.name, name.c_str(), name.size());
+            found = video_of_name.emplace(name, videos.size()).first;
+            videos.emplace_back(video);
+            video_sizes.emplace_back();
+        }
+        int v = found->second;
+        uint32_t &indexed = video_sizes[v][{segment, layer}];
+        if (indexed == size)
+            return false;
+        indexed = size;
+        videos[v].segment_qty = std::max<uint32_t>(videos[v].segment_qty, segment + 1);
+        layer_qty = std::max<uint32_t>(layer_qty, layer + 1);
+        return true;
+    }
 
-            // auto i = net_topo.Server_OF_SWs_Connections[s + net_topo.srv_qty];//sws e index comes after servers
-            if (i != net_topo.Server_OF_SWs_Connections.end())
+    void publish()
+    {
+        try
+        {
+            std::string next_path = catalog_path + ".next";
+            pack_segment_catalog(videos, video_sizes, layer_qty, sizes);
+            write_segment_catalog(next_path, videos, layer_qty, sizes);
+            fs::rename(next_path, catalog_path); // mappings of older snapshots keep the replaced file
+            std::atomic_store(&current, std::shared_ptr<const Segment_Catalog>(std::make_shared<const Segment_Catalog>(catalog_path)));
             {
-                for (auto j : i->second)
-                {
-                    // cout << "f_sc_ij: ";
-                    // cout << s << c << i->first << j << "\n";
-                    f_sc_ij_const_1_ExprArr[0] += f_sc_ij[s][c][i->first][j]; // - f_sc_gamma_ij[s][c][i->first][j];
-                    f_sc_ij_const_1_ExprArr[1] += f_sc_ij[s][c][j][i->first]; // - f_sc_gamma_ij[s][c][j][i->first];
-                    // cout << "f_" << s << c << i->first << j << " - " << "f_" << s << c << j << i->first << "\n";
-                }
+                std::unique_lock<std::mutex> lock(epoch_mutex);
+                published_epoch++;
             }
-
-            // cout << " = r_" << s << c << "\n";
-            model.add(f_sc_ij_const_1_ExprArr[0] - f_sc_ij_const_1_ExprArr[1] == r_sc[s][c]); // + r_sc_gamma[s][c]);
-            // cout << "f_sc_ij_const_1_ExprArr[0]: " << f_sc_ij_const_1_ExprArr[0] << "\n";
-
-            f_sc_ij_const_1_ExprArr.end();
+            epoch_published.notify_all();
+        }
+        catch (const std::exception &e)
+        {
+            cout << "segment catalog update failed, cycles keep the previous one: " << e.what() << "\n";
         }
     }
 
-    // f_sc_ij constraint 2 --- if i = V \ S U C
-    for (int s = 0; s < server_site_sws_qty; s++)
+    std::string media_root;
+    std::string catalog_path;
+    std::shared_ptr<const Segment_Catalog> current;
+    std::atomic<int> published_epoch{0};
+    std::atomic<bool> stopping{false};
+    std::mutex epoch_mutex; // published_epoch and stopping are changed under it for wait_epoch()
+    std::condition_variable epoch_published;
+    int inotify_fd = -1;
+    std::thread watcher;
+    // index of the watcher thread
+    std::unordered_map<int, fs::path> watched_dirs;
+    std::unordered_map<std::string, int> video_of_name;
+    std::vector<Catalog_Video> videos;
+    std::vector<Segment_Sizes> video_sizes;
+    std::vector<uint32_t> sizes;
+    uint32_t layer_qty = 0;
+};
+
+// Layer rates of clients (b_bar_cl). A client refers to a rate row shared by every client on the same (video, segment), so demand
+// takes memory per distinct segment in flight, not per client. b_bar_cl[c][l] reads client c's row. Rate sums of each cssw are
+// kept up to date as clients are assigned rows.
+class Demand_Model
+{
+public:
+    struct Rate_Row
     {
-        // f_sc_ij_const_1_ExprArr[s] =  IloArray<IloExprArray>(multiserverEnv, client_site_sws_qty);
-        for (int c = 0; c < client_site_sws_qty; c++)
-        {
-
-            // cout << "cons 2 \n";
-            int count_i = 2;
-            for (auto i : net_topo.OF_SWs_No_SSSWs)
-            {
-                IloExprArray f_sc_ij_const_2_ExprArr(multiserverEnv, 2);
-                f_sc_ij_const_2_ExprArr[0] = IloExpr(multiserverEnv);
-                f_sc_ij_const_2_ExprArr[1] = IloExpr(multiserverEnv);
-                // cout << "f_sc_ij: " << s << c << i << "_";
+        const double *first;
+        const double *last;
+        double operator[](int l) const { return first[l]; }
+        const double *begin() const { return first; }
+        const double *end() const { return last; }
+        int size() const { return last - first; }
+    };
+
+    // clients are on no row (zero rates) until assign(). Rows are dropped, buffers are kept for reuse.
+    void reset(int requests_qty, int layer_qty, const std::vector<int> &client_cssw, int cssw_qty)
+    {
+        m_c = layer_qty;
+        cssw_of_client = &client_cssw;
+        rows.assign(m_c, 0.0); // row 0 is the zero row
+        row_sums.assign(1, 0.0);
+        row_of_key.clear();
+        client_row.assign(requests_qty, 0);
+        cssw_rates.assign(cssw_qty, 0.0);
+        total = 0;
+    }
 
-                for (auto j : net_topo.OF_SWs_No_SSSWs_Connections[i])
-                {
-                    // cout << j << " - ";
+    // row of (video, segment), -1 if no client is on it yet
+    int find_row(int video, int segment) const
+    {
+        auto row_itr = row_of_key.find(row_key(video, segment));
+        return row_itr == row_of_key.end() ? -1 : row_itr->second;
+    }
 
-                    // cout << "cons 2 --- f_sc_ij: "<< s << c << i << j <<" - " << "cons 2 --- f_sc_ji: "<< s << c << j << i <<"\n";
-                    // cout << s << c << i << j << "\n";
-                    f_sc_ij_const_2_ExprArr[0] += f_sc_ij[s][c][i][j]; // - f_sc_gamma_ij[s][c][i][j];
-                    f_sc_ij_const_2_ExprArr[1] += f_sc_ij[s][c][j][i]; // - f_sc_gamma_ij[s][c][j][i];
-                }
-                model.add(f_sc_ij_const_2_ExprArr[0] - f_sc_ij_const_2_ExprArr[1] == 0);
-                // cout <<    "count_i: " << count_i++<<"\n";
-                // cout <<"f_sc_ij_const_2_ExprArr[1]: "<<f_sc_ij_const_2_ExprArr[1]<<"\n";
-                f_sc_ij_const_2_ExprArr.end();
-            }
-        }
+    // row of (video, segment), added with rates if it's the first client on it
+    int row(int video, int segment, const double *rates)
+    {
+        int r = find_row(video, segment);
+        if (r >= 0)
+            return r;
+        r = add_row(rates);
+        row_of_key.emplace(row_key(video, segment), r);
+        return r;
     }
 
-    /*
-    // f_sc_ij constraint 3 --- if i  Elenment of Clients site switches
-    for (int s = 0; s < server_site_sws_qty; s++)
+    // a row of its own, e.g. synthetic clients of the benchmarks
+    int add_row(const double *rates)
     {
-        // f_sc_ij_const_1_ExprArr[s] =  IloArray<IloExprArray>(multiserverEnv, client_site_sws_qty);
-        for (int c = 0; c < client_site_sws_qty; c++)
-        {
-            IloExprArray f_sc_ij_const_3_ExprArr(multiserverEnv, 2);
-            f_sc_ij_const_3_ExprArr[0] = IloExpr(multiserverEnv);
-            f_sc_ij_const_3_ExprArr[1] = IloExpr(multiserverEnv);
-            auto i = net_topo.C_OF_SWs_Connections.find(c + net_topo.srv_qty + net_topo.OF_SWs.size());
-            cout << "cons 3 \n";
-            if (i != net_topo.C_OF_SWs_Connections.end())
-            {
-                cout << "f_sc_ij: "<< s << c << i->first <<"_";
-                for (auto j : i->second)
-                {
+        rows.insert(rows.end(), rates, rates + m_c);
+        row_sums.emplace_back(std::accumulate(rates, rates + m_c, 0.0));
+        return row_sums.size() - 1;
+    }
 
-                    cout << j << " - ";
-                    // cout << s << c << i << j << "\n";
-                    //  cout <<"scij: " << s << c << i<< j <<"\n";
+    void assign(int c, int r)
+    {
+        double delta = row_sums[r] - row_sums[client_row[c]];
+        cssw_rates[(*cssw_of_client)[c]] += delta;
+        total += delta;
+        client_row[c] = r;
+    }
 
-                    f_sc_ij_const_3_ExprArr[0] += f_sc_ij[s][c][i->first][j]; // - f_sc_gamma_ij[s][c][i->first][j];
-                    f_sc_ij_const_3_ExprArr[1] += f_sc_ij[s][c][j][i->first]; // - f_sc_gamma_ij[s][c][j][i->first];
-                }
+    Rate_Row operator[](int c) const
+    {
+        const double *first = rows.data() + (size_t)client_row[c] * m_c;
+        return {first, first + m_c};
+    }
+    int size() const { return client_row.size(); }
+    int row_qty() const { return row_sums.size() - 1; }
+    double cssw_rate(int y) const { return cssw_rates[y]; } // sum of layer rates of clients of cssw y
+    double total_rate() const { return total; }
+
+private:
+    static uint64_t row_key(int video, int segment) { return (uint64_t)(uint32_t)video << 32 | (uint32_t)segment; }
+
+    int m_c = 0;
+    const std::vector<int> *cssw_of_client = nullptr;
+    std::vector<double> rows; // m_c rates per row
+    std::vector<double> row_sums;
+    std::unordered_map<uint64_t, int> row_of_key; // (video, segment) of keyed rows
+    std::vector<int> client_row;
+    std::vector<double> cssw_rates;
+    double total = 0;
+};
+
+// Title (catalog video) and segment each client is playing. The client request path calls on_request() for each segment request,
+// the prepare stage takes a copy ordered by (title, segment) to build the demand of the next cycle.
+class Client_Sessions
+{
+public:
+    struct Session
+    {
+        int title;
+        int segment;
+        int client;
+    };
 
-                model.add(f_sc_ij_const_3_ExprArr[0] - f_sc_ij_const_3_ExprArr[1] == -r_sc[s][c]);
-            }
-            f_sc_ij_const_3_ExprArr.end();
-        }
+    explicit Client_Sessions(int requests_qty) : sessions(requests_qty)
+    {
+        for (int c = 0; c < requests_qty; c++)
+            sessions[c] = {0, 0, c};
     }
-    */
 
-    // BW limitation
-    for (int i = net_topo.srv_qty; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+    void on_request(int c, int title, int segment)
     {
-        for (int j = net_topo.srv_qty; j < net_topo.sw_qty + net_topo.srv_qty; j++)
-        {
-            IloExpr f_sc_ij_bw_expr(multiserverEnv);
-            for (int s = 0; s < server_site_sws_qty; s++)
-            {
-                for (int c = 0; c < client_site_sws_qty; c++)
-                {
-                    if (net_topo.e[i][j] == 1)
-                    {
-                        f_sc_ij_bw_expr += f_sc_ij[s][c][i][j]; //+ f_sc_gamma_ij[s][c][i][j];
-                        // cout << "cons 4 --- f_sc_ij: ";
-                        // cout << s << c << i << j << "\n";
-                    }
-                }
-            }
-            if (net_topo.e[i][j] == 1)
-            {
-                model.add(f_sc_ij_bw_expr + gamma_ij[i][j] <= net_topo.b_ij[i][j]);
-                // cout << "net_topo.b_ij["<< i<< "]["<<j<<"]" <<net_topo.b_ij[i][j] << "\t";
-            }
-            f_sc_ij_bw_expr.end();
-        }
-        // cout << "\n";
+        std::unique_lock<std::mutex> lock(mutex);
+        sessions[c].title = title;
+        sessions[c].segment = segment;
     }
 
-    // minimize BW usage by selecting shortest path
-    IloExpr f_sc_ij_obj_expr(multiserverEnv);
-    // IloExpr f_sc_gamma_ij_obj_expr(multiserverEnv);
-    for (int s = 0; s < server_site_sws_qty; s++)
+    // sessions ordered by title, then segment. Clients on the same segment are next to each other, so each segment's catalog entry
+    // and rate row are touched once and in catalog order. order is the previous cycle's order, its sessions are refreshed in place
+    // and sorted again. Sessions change little between cycles, so it's nearly sorted.
+    void sorted(std::vector<Session> &order)
     {
-        for (int c = 0; c < client_site_sws_qty; c++)
         {
-            for (int i = net_topo.srv_qty; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+            std::unique_lock<std::mutex> lock(mutex);
+            if (order.size() == sessions.size())
             {
-                for (int j = net_topo.srv_qty; j < net_topo.sw_qty + net_topo.srv_qty; j++)
-                {
-                    if (net_topo.e[i][j] == 1)
-                    {
-                        // cout << "const minimize BW --- f_sc_ij: ";
-                        // cout << s << c << i << j << "\n";
-                        f_sc_ij_obj_expr += f_sc_ij[s][c][i][j];
-                        // f_sc_gamma_ij_obj_expr += f_sc_gamma_ij[s][c][i][j];
-                    }
-                }
+                for (Session &o : order)
+                    o = sessions[o.client];
             }
+            else
+                order = sessions;
         }
+        std::sort(order.begin(), order.end(), [](const Session &a, const Session &b)
+                  { return a.title != b.title ? a.title < b.title : a.segment < b.segment; });
     }
 
-    IloExpr gamma_ij_obj_expr(multiserverEnv);
-    for (int i = net_topo.srv_qty; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+private:
+    std::vector<Session> sessions;
+    std::mutex mutex;
+};
+
+// b_bar_cl of a cycle from clients' sessions. Layer rates are computed once for each (title, segment) in flight and its clients
+// share the row.
+void set_b_bar_cl(Demand_Model &b_bar_cl, const std::vector<Client_Sessions::Session> &order, int m_c, const Segment_Catalog &catalog, double teta)
+{
+    double toMegabit = 8.0 / (1000 * 1000);
+    const int http_header_size = 500; // Ortalama header size 500 Byte olarak belirlenmiştir. İHTİYAÇ DUYULURSA DAHA KESİN BİR DEĞER GİRİLEBİLİR.
+    std::vector<double> layer_rates(m_c);
+    int row = 0;
+    for (size_t i = 0; i < order.size(); i++)
     {
-        for (int j = net_topo.srv_qty; j < net_topo.sw_qty + net_topo.srv_qty; j++)
+        const Client_Sessions::Session &session = order[i];
+        if (i == 0 || session.title != order[i - 1].title || session.segment != order[i - 1].segment)
         {
-            if (net_topo.e[i][j] == 1)
+            for (int j = 0; j < m_c; j++)
             {
-                // gamma_ij_obj_expr += gamma_ij[i][j]*( 1.2 - net_topo.b_ij[i][j]/net_topo.link_capacity[i][j] );
-                // gamma_ij_obj_expr += gamma_ij[i][j] * (1.5 - net_topo.b_ij[i][j] / net_topo.link_capacity[i][j]);
-                // gamma_ij_obj_expr += gamma_ij[i][j] * (1.0 + net_topo.b_ij[i][j] / net_topo.link_capacity[i][j]);
-                // gamma_ij_obj_expr += gamma_ij[i][j] * (2.0 - net_topo.b_ij[i][j] / net_topo.link_capacity[i][j]);
-                gamma_ij_obj_expr += gamma_ij[i][j];
+                // each layer size of segment is recorded and converted to bandwith requirement (Byte per second) diving file size to 2(teta)
+                layer_rates[j] = (/*Network Overhead*/ (1.054 * (catalog.size(session.title, session.segment, j) + http_header_size)) * toMegabit) / teta; // Required BW to download this layer on time - Byte per second.
             }
+            row = b_bar_cl.row(session.title, session.segment, layer_rates.data());
         }
+        b_bar_cl.assign(session.client, row);
     }
-    // model.add(IloMinimize(multiserverEnv, -10 * exp_r_sc_obj + f_sc_ij_obj_expr - gamma_ij_obj_expr /*- f_sc_gamma_ij_obj_expr*/));
-
-    // model.add(IloMinimize(multiserverEnv, -10 * exp_r_sc_obj + f_sc_ij_obj_expr));
-    model.add(IloMinimize(multiserverEnv, -10 * exp_r_sc_obj + f_sc_ij_obj_expr - gamma_ij_obj_expr));
-
-    // model.add(IloMinimize(multiserverEnv, -30 * exp_r_sc_obj + f_sc_ij_obj_expr - 2*gamma_ij_obj_expr /*- f_sc_gamma_ij_obj_expr*/));
-    // model.add(IloMinimize(multiserverEnv, -100 * exp_r_sc_obj + 3*f_sc_ij_obj_expr - 2*gamma_ij_obj_expr /*- f_sc_gamma_ij_obj_expr*/));
-    // model.add(IloMinimize(multiserverEnv, -10 * exp_r_sc_obj + f_sc_ij_obj_expr));
-    // model.add(IloMinimize(multiserverEnv, -100000 * exp_r_sc_obj + f_sc_ij_obj_expr));
-    f_sc_ij_obj_expr.end();
-    // model.add(IloMinimize(multiserverEnv, -100 * exp_r_sc_obj));
-    exp_r_sc_obj.end();
-    gamma_ij_obj_expr.end();
-    IloCplex multiserverCplex(model);
-    multiserverCplex.setOut(multiserverEnv.getNullStream()); // Disable CPLEX logging
-    multiserverCplex.setWarning(multiserverEnv.getNullStream());
-    // multiserverCplex.setParam(IloCplex::Param::TimeLimit, 1.0);
+} // end of update_b_bar_c_l func
 
-    if (multiserverCplex.solve())
+int total_layer_qty(const Demand_Model &b_bar_cl, int requests_qty)
+{
+    int total_layer_qty = 0;
+    for (int i = 0; i < requests_qty; i++)
+    {
+        total_layer_qty += b_bar_cl[i].size();
+    }
+    return total_layer_qty;
+}
+// Results of the multiserver stage. They're allocated once and overwritten at each solve, so optimizer cycles don't need their own env
+struct Multiserver_Results
+{
+    ~Multiserver_Results()
     {
-        // IloNumArray4 f_sc_ij_sol(multiserverEnv, server_site_sws_qty);
+        env.end();
+    }
 
-        multiserverCplex.exportModel("multiServerModel.lp");
-        IloAlgorithm::Status solStatus = multiserverCplex.getStatus();
-        // cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!multiserver Status: " << solStatus << "\n";
-        //  multiserverCplex.getValues(f_sc_ij[s][c][i]);
+    IloEnv env;
+    IloNumArray2 r_sc_sol;
+    IloNumArray2 r_sc_gamma_sol;
+    IloNumArray2 gamma_ij_sol;
+    IloNumArray4 f_sc_ij_sol;
+    bool arc_flows_allocated = false;
 
+    // arc_flows = false leaves f_sc_ij_sol empty, the path formulation gives its flows as paths
+    void allocate_results(Net_Topo &net_topo, bool arc_flows = true)
+    {
+        arc_flows_allocated = arc_flows;
+        int server_site_sws_qty = net_topo.ServerSideOFSWs.size();
+        int client_site_sws_qty = net_topo.ClientSideOFSWs.size();
+        int e_qty = net_topo.srv_qty + net_topo.sw_qty;
+        r_sc_sol = IloNumArray2(env, server_site_sws_qty);
+        r_sc_gamma_sol = IloNumArray2(env, server_site_sws_qty);
         for (int s = 0; s < server_site_sws_qty; s++)
         {
-            // r_sc_sol[s] = IloNumArray(multiserverEnv, client_site_sws_qty);
-            multiserverCplex.getValues(r_sc[s], r_sc_sol[s]);
-            // multiserverCplex.getValues(r_sc_gamma[s], r_sc_gamma_sol[s]);
-            // cout << "r_sc[" << s << "]" << r_sc_sol[s] << "\n";
+            r_sc_sol[s] = IloNumArray(env, client_site_sws_qty);
+            r_sc_gamma_sol[s] = IloNumArray(env, client_site_sws_qty);
         }
-
-        for (int i = net_topo.srv_qty; i < (net_topo.srv_qty + net_topo.sw_qty); i++)
+        gamma_ij_sol = IloNumArray2(env, e_qty);
+        for (int i = net_topo.srv_qty; i < e_qty; i++)
         {
-            for (int j = net_topo.srv_qty; j < net_topo.srv_qty + net_topo.sw_qty; j++)
+            gamma_ij_sol[i] = IloNumArray(env, e_qty);
+        }
+        if (!arc_flows)
+            return;
+        f_sc_ij_sol = IloNumArray4(env, server_site_sws_qty);
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            f_sc_ij_sol[s] = IloNumArray3(env, client_site_sws_qty);
+            for (int c = 0; c < client_site_sws_qty; c++)
             {
-                if (net_topo.e[i][j] == 1)
+                f_sc_ij_sol[s][c] = IloNumArray2(env, e_qty);
+                for (int i = net_topo.srv_qty; i < e_qty; i++)
                 {
-                    gamma_ij_sol[i][j] = multiserverCplex.getValue(gamma_ij[i][j]);
-
-                    // if (gamma_ij_sol[i][j] > 0)
-                    // cout << "gamma_ij_sol[" << i << j << "]" << gamma_ij_sol[i][j] << "\n";
-                    // cout <<"net_topo.link_capacity["<<i<<"]["<<j<<"]:" << net_topo.link_capacity[i][j]<<"\n";
+                    f_sc_ij_sol[s][c][i] = IloNumArray(env, e_qty);
                 }
             }
         }
+    }
 
-        // IloArray<IloArray<IloArray<IloNumArray>>> f_sc_ij_sol(multiserverEnv, server_site_sws_qty);
-        // IloNumArray4 f_sc_gamma_ij_sol(multiserverEnv, server_site_sws_qty);
+    // no rate and no flow, used when a solve fails so that the previous cycle's results aren't used again
+    void clear_results(Net_Topo &net_topo)
+    {
+        int server_site_sws_qty = net_topo.ServerSideOFSWs.size();
+        int client_site_sws_qty = net_topo.ClientSideOFSWs.size();
+        int e_qty = net_topo.srv_qty + net_topo.sw_qty;
         for (int s = 0; s < server_site_sws_qty; s++)
         {
-            f_sc_ij_sol[s] = IloNumArray3(multiserverEnv, client_site_sws_qty);
             for (int c = 0; c < client_site_sws_qty; c++)
             {
-                f_sc_ij_sol[s][c] = IloNumArray2(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty));
-                for (int i = net_topo.srv_qty; i < (net_topo.srv_qty + net_topo.sw_qty); i++)
+                r_sc_sol[s][c] = 0;
+                r_sc_gamma_sol[s][c] = 0;
+                for (int i = net_topo.srv_qty; arc_flows_allocated && i < e_qty; i++)
                 {
-                    f_sc_ij_sol[s][c][i] = IloNumArray(multiserverEnv, (net_topo.sw_qty + net_topo.srv_qty));
-                    for (int j = net_topo.srv_qty; j < net_topo.srv_qty + net_topo.sw_qty; j++)
-                    {
-                        if (net_topo.e[i][j] == 1)
-                        {
-                            f_sc_ij_sol[s][c][i][j] = multiserverCplex.getValue(f_sc_ij[s][c][i][j]);
-                            // IloNum f_sc_ij_sol = multiserverCplex.getValue(f_sc_ij[s][c][i][j]);
-                            //  IloNum f_sc_gamma_ij_sol = multiserverCplex.getValue(f_sc_gamma_ij[s][c][i][j]);
-                            //  if (f_sc_ij_sol > 0)
-                            //  cout << "f_sc_ij_sol[" << s << c << i << j << "]" << f_sc_ij_sol << "\n";
-                        }
-                    }
+                    for (int j = 0; j < e_qty; j++)
+                        f_sc_ij_sol[s][c][i][j] = 0;
                 }
             }
         }
-        /*
-        for (int i = net_topo.srv_qty; i < (net_topo.srv_qty + net_topo.sw_qty); i++)
+        for (int i = net_topo.srv_qty; i < e_qty; i++)
         {
-            for (int j = net_topo.srv_qty; j < net_topo.srv_qty + net_topo.sw_qty; j++)
-            {
-                if (net_topo.e[i][j] == 1)
-                {
-                    IloNum gamma_ij_sol = multiserverCplex.getValue(gamma_ij[i][j]);
-                    if (gamma_ij_sol > 0)
-                        cout << "gamma_ij_sol[" << i << j << "]" << gamma_ij_sol << "\n";
-                    cout <<"net_topo.link_capacity["<<i<<"]["<<j<<"]:" << net_topo.link_capacity[i][j]<<"\n";
-                }
-            }
+            for (int j = 0; j < e_qty; j++)
+                gamma_ij_sol[i][j] = 0;
         }
-        */
     }
+};
 
-    // updates provided_rate_for_c vector
-    int cssw_qty = net_topo.ClientSideOFSWs.size();
-    int sssw_qty = net_topo.ServerSideOFSWs.size();
+// Keeps a multiserver LP alive between optimization cycles. The model is built once from Net_Topo, link capacity changes recorded
+// in Net_Topo (Topo_Delta) are applied as bound/RHS changes and the LP is re-solved from the previous basis instead of being rebuilt.
+// Both formulations, per arc (Multiserver_LP) and per candidate path (Multiserver_Path_LP), have a BW row for each sw to sw edge
+// and a rate row for each sssw, they're patched here.
+class Multiserver_Live_LP : public Multiserver_Results
+{
+public:
+    Multiserver_Live_LP(Net_Topo &net_topo) : net_topo(net_topo), model(env), multiserverCplex(env)
+    {
+        server_site_sws_qty = net_topo.ServerSideOFSWs.size();
+        client_site_sws_qty = net_topo.ClientSideOFSWs.size();
+    }
+    virtual ~Multiserver_Live_LP() {}
+
+    Net_Topo &net_topo;
+    IloModel model;
+    IloCplex multiserverCplex;
+    int server_site_sws_qty;
+    int client_site_sws_qty;
+    std::vector<IloRange> edge_bw_ranges;   // BW limitation constraint of each sw to sw CSR edge
+    std::vector<IloRange> sssw_rate_ranges; // upper bound of r_sc according to x's connections, indexed by sssw
+    std::vector<double> applied_bw;         // RHS currently set on edge_bw_ranges, per CSR edge. Compared with net_topo.edge_b to find changed rows
+    std::chrono::duration<double, std::milli> build_time;
+
+    // patches the live model with link changes recorded in net_topo. Extracted model changes are passed to CPLEX incrementally.
+    // Capacity changes move gamma bounds; BW rows are updated by update_bw_rhs(). Returns number of changed rows.
+    virtual int apply_deltas(const std::vector<Net_Topo::Topo_Delta> &deltas) = 0;
+    // copies the solution to r_sc_sol, gamma_ij_sol and the formulation's flows
+    virtual void get_solution() = 0;
+    // clears them when there's no solution
+    virtual void clear_solution() { clear_results(net_topo); }
+
+    void set_solver_params()
+    {
+        multiserverCplex.setOut(env.getNullStream()); // Disable CPLEX logging
+        multiserverCplex.setWarning(env.getNullStream());
+        // multiserverCplex.setParam(IloCplex::Param::TimeLimit, 1.0);
+        multiserverCplex.setParam(IloCplex::Param::RootAlgorithm, IloCplex::Dual); // after bound/RHS changes the previous basis stays dual feasible
+        multiserverCplex.setParam(IloCplex::Param::Advance, 1);                    // re-solves start from the previous optimal basis
+    }
 
-    for (int s = 0; s < sssw_qty; s++)
+    // sum of avaiable bw on x's connections
+    double bit_rate_of_x(int x)
     {
-        for (int c = 0; c < cssw_qty; c++)
+        double bit_rate = 0.0;
+        for (auto j : net_topo.Server_OF_SWs_Connections[x])
         {
-            provided_rate_for_c[c] = 0;
+            bit_rate += net_topo.available_bw(x, j);
         }
+        return bit_rate;
     }
 
-    for (int s = 0; s < sssw_qty; s++)
+    // only BW rows whose avaiable bw differs from the applied RHS are changed, then rate rows of the sssws owning them
+    int update_bw_rhs()
     {
-        for (int c = 0; c < cssw_qty; c++)
+        int changed_rows = 0;
+        std::vector<bool> sssw_changed(server_site_sws_qty, false);
+        for (int i = net_topo.srv_qty; i < net_topo.sw_qty + net_topo.srv_qty; i++)
         {
-            provided_rate_for_c[c] += r_sc_sol[s][c];
+            for (int j : net_topo.neighbours(i))
+            {
+                int k = net_topo.edge_index(i, j);
+                if (j < net_topo.srv_qty || !edge_bw_ranges[k].getImpl() || applied_bw[k] == net_topo.edge_b[k])
+                    continue;
+                applied_bw[k] = net_topo.edge_b[k];
+                edge_bw_ranges[k].setUB(applied_bw[k]);
+                changed_rows++;
+                if (net_topo.server_side_sw[i])
+                    sssw_changed[i - net_topo.srv_qty] = true;
+            }
         }
-    }
-    for (int c = 0; c < cssw_qty; c++)
-    {
-        if (provided_rate_for_c[c] == 0)
+        for (int s = 0; s < server_site_sws_qty; s++)
         {
-            cout << "---!!! Multiserver() called again\n";
-            multiserver(multiserverEnv, net_topo, b_bar_cl, m_c, r_sc_sol, r_sc_gamma_sol, gamma_ij_sol, provided_rate_for_c, f_sc_ij_sol);
+            if (sssw_changed[s] && sssw_rate_ranges[s].getImpl())
+            {
+                sssw_rate_ranges[s].setUB(bit_rate_of_x(s + net_topo.srv_qty));
+                changed_rows++;
+            }
         }
+        return changed_rows;
     }
 
-} // End of multiserver function
+    IloBool solve()
+    {
+        return multiserverCplex.solve();
+    }
+};
 
-//This function is used to initilize IBM CPLEX variables during at our first approach (before OPM) which we find the solution up 8 iteration. Later we keep it even no more than 1 iteration between master (OPM) and worker (CPM). 
-void masterInitBuilder(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumVar Q, IloNumVar L, IloNumVarArray T_c, IloNumVarArray I_c, IloIntVarArray v_c, IloNumVarArray N_c, int requests_qty,
-                       vector2d b_bar_cl, Net_Topo net_topo, int m_c, int a_s_cl, IloExpr masterOptConstExpr, IloArray<IloRangeArray> masterConst1_RangeArr,
-                       IloArray<IloArray<IloRangeArray>> masterConst2_RangeArr, IloArray<IloRangeArray> masterConst3_RangeArr, IloRangeArray masterConst4_RangeArr1, IloRangeArray masterConst4_RangeArr2,
-                       IloRangeArray masterConst5_RangeArr, IloRangeArray masterConst6_RangeArr, IloRangeArray masterConst7_RangeArr1,
-                       IloRangeArray masterConst7_RangeArr2, IloRangeArray masterConst8_RangeArr, int phi_c)
+// Arc formulation of the multiserver LP, f_sc_ij for every commodity on every (i, j) of the core grid
+class Multiserver_LP : public Multiserver_Live_LP
 {
-    int layer_qty;
+public:
+    Multiserver_LP(Net_Topo &net_topo) : Multiserver_Live_LP(net_topo)
+    {
+        auto build_start_time = std::chrono::steady_clock::now();
+        build();
+        allocate_results(net_topo);
+        build_time = std::chrono::steady_clock::now() - build_start_time;
+        cout << "multiserver LP built in " << build_time.count() << " ms\n";
+    }
 
-    // w_s_cl vars init & masterOptConstExpr init
-    for (int i = 0; i < requests_qty; i++)
+    IloNumVarArray2 r_sc;                   // variables to get bw rate server site sws to client site sws
+    IloNumVarArray4 f_sc_ij;                // variables to get bw rate on all edges for sssws (server site sws) and cssws (client site sws)
+    IloNumVarArray2 gamma_ij;               // free capacity kept on edges against burst usage
+
+    void build()
     {
-        layer_qty = m_c;
-        // cout << "m_c 11:" << m_c << "\n";
+        r_sc = IloNumVarArray2(env, server_site_sws_qty);
+        f_sc_ij = IloNumVarArray4(env, server_site_sws_qty);
+        gamma_ij = IloNumVarArray2(env, (net_topo.srv_qty + net_topo.sw_qty));
 
-        // layer_qty = b_bar_cl[i].size();
-        w_s_cl[i] = IloArray<IloIntVarArray>(masterEnv, layer_qty); // defining layer array of each c
-        for (int j = 0; j < layer_qty; j++)
+        // object function for r_sc
+        IloExpr exp_r_sc_obj(env);
+        // r_sc variables are declared & initilized
+        for (int s = 0; s < server_site_sws_qty; s++)
         {
-            w_s_cl[i][j] = IloIntVarArray(masterEnv, net_topo.srv_qty, 0, 1); // defining cplex variable array for w
-            for (int k = 0; k < net_topo.srv_qty; k++)
+            r_sc[s] = IloNumVarArray(env, client_site_sws_qty);
+            for (int c = 0; c < client_site_sws_qty; c++)
             {
-                // w_s_cl[i][j][k] = IloNumVar(env, 0, 1, IloNumVar::Int); //cplex variables definition which is about if server will be send the layer or not to c
-                char varName[100]; // used to assign variable names in IntVarArrays
-                sprintf(varName, "w_s:%d_c:%d_l:%d", k, i, j);
-                w_s_cl[i][j][k].setName(varName);      // std::cout << typeid(t_cl_ij[i][j][k][l]).name() << " - "; //sub problem 1 objective funciton content
-                                                       // std::cout << typeid(w_s_cl[i][j][k]).name() << " - "; //sub problem 1 objective funciton content
-                                                       // each server - e array's first srv_qty element contraints servers. so loop starts from 0
-                masterOptConstExpr += w_s_cl[i][j][k]; // builds masterOptConstExpr - TOPLAM KAÇ TANE W_S_CL == 1 OLDUĞUNU BELİRLEMEK İÇİN KULLANILIYOR.
+                r_sc[s][c] = IloNumVar(env, 0, IloInfinity);
+                exp_r_sc_obj += r_sc[s][c];
             }
-            // std::cout << "\n";
         }
-        // std::cout << "\n";
+
+        //The constraint, upper bound according to x's connections
+        sssw_rate_ranges.resize(server_site_sws_qty);
+        for (int x : net_topo.ServerSideOFSWs)
+        {
+            if (net_topo.Server_OF_SWs_Connections[x].size() == 0)
+                continue;
+            IloExpr exp_r_sc_const2(env);
+            for (int y = 0; y < client_site_sws_qty; y++)
+            {
+                exp_r_sc_const2 += r_sc[x - net_topo.srv_qty][y];
+            }
+            sssw_rate_ranges[x - net_topo.srv_qty] = (exp_r_sc_const2 <= bit_rate_of_x(x));
+            model.add(sssw_rate_ranges[x - net_topo.srv_qty]);
+            exp_r_sc_const2.end();
+        }
+
+        for (int i = 0; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+        {
+            gamma_ij[i] = IloNumVarArray(env, (net_topo.sw_qty + net_topo.srv_qty));
+            for (int j = 0; j < (net_topo.sw_qty + net_topo.srv_qty); j++)
+            {
+                gamma_ij[i][j] = IloNumVar(env, 0, net_topo.capacity(i, j) / (double)10.0); // If there is enough capacity, it tries to keep 10% of the link capacity free against burst usage
+                if (!net_topo.has_edge(i, j) || i < net_topo.srv_qty) // No need for servers
+                {
+                    gamma_ij[i][j].setBounds(0, 0);
+                }
+            }
+        }
+
+        // f_sc_ij variables are declared & initilized
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            f_sc_ij[s] = IloNumVarArray3(env, client_site_sws_qty);
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                f_sc_ij[s][c] = IloNumVarArray2(env, (net_topo.sw_qty + net_topo.srv_qty));
+                for (int i = 0; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+                {
+                    f_sc_ij[s][c][i] = IloNumVarArray(env, (net_topo.sw_qty + net_topo.srv_qty), 0, IloInfinity); // defining vertex array's 2nd dimention which contain cplex variable array
+                    for (int j = 0; j < (net_topo.sw_qty + net_topo.srv_qty); j++)
+                    {
+                        if (!net_topo.has_edge(i, j) || i < net_topo.srv_qty) // No need servers
+                        {
+                            f_sc_ij[s][c][i][j].setBounds(0, 0);
+                        }
+                    }
+                }
+            }
+        }
+
+        //  f_sc_ij constraint 1 --- if i Element of SSSWs
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                IloExpr f_sc_ij_out_expr(env);
+                IloExpr f_sc_ij_in_expr(env);
+                int i = s + net_topo.srv_qty; // sws e index comes after servers
+                for (auto j : net_topo.Server_OF_SWs_Connections[i])
+                {
+                    f_sc_ij_out_expr += f_sc_ij[s][c][i][j];
+                    f_sc_ij_in_expr += f_sc_ij[s][c][j][i];
+                }
+                model.add(f_sc_ij_out_expr - f_sc_ij_in_expr == r_sc[s][c]);
+                f_sc_ij_out_expr.end();
+                f_sc_ij_in_expr.end();
+            }
+        }
+
+        // f_sc_ij constraint 2 --- if i = V \ S U C
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                for (auto i : net_topo.OF_SWs_No_SSSWs)
+                {
+                    IloExpr f_sc_ij_out_expr(env);
+                    IloExpr f_sc_ij_in_expr(env);
+                    for (auto j : net_topo.OF_SWs_No_SSSWs_Connections[i])
+                    {
+                        f_sc_ij_out_expr += f_sc_ij[s][c][i][j];
+                        f_sc_ij_in_expr += f_sc_ij[s][c][j][i];
+                    }
+                    model.add(f_sc_ij_out_expr - f_sc_ij_in_expr == 0);
+                    f_sc_ij_out_expr.end();
+                    f_sc_ij_in_expr.end();
+                }
+            }
+        }
+
+        // BW limitation - only existing sw to sw edges are traversed
+        edge_bw_ranges.assign(net_topo.edge_qty(), IloRange());
+        applied_bw.assign(net_topo.edge_qty(), 0.0);
+        for (int i = net_topo.srv_qty; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+        {
+            for (int j : net_topo.neighbours(i))
+            {
+                if (j < net_topo.srv_qty)
+                    continue; // servers aren't limited here
+                IloExpr f_sc_ij_bw_expr(env);
+                for (int s = 0; s < server_site_sws_qty; s++)
+                {
+                    for (int c = 0; c < client_site_sws_qty; c++)
+                    {
+                        f_sc_ij_bw_expr += f_sc_ij[s][c][i][j];
+                    }
+                }
+                int k = net_topo.edge_index(i, j);
+                applied_bw[k] = net_topo.available_bw(i, j);
+                edge_bw_ranges[k] = (f_sc_ij_bw_expr + gamma_ij[i][j] <= applied_bw[k]);
+                model.add(edge_bw_ranges[k]);
+                f_sc_ij_bw_expr.end();
+            }
+        }
+
+        // minimize BW usage by selecting shortest path
+        IloExpr f_sc_ij_obj_expr(env);
+        IloExpr gamma_ij_obj_expr(env);
+        for (int i = net_topo.srv_qty; i < net_topo.sw_qty + net_topo.srv_qty; i++)
+        {
+            for (int j : net_topo.neighbours(i))
+            {
+                if (j < net_topo.srv_qty)
+                    continue;
+                for (int s = 0; s < server_site_sws_qty; s++)
+                {
+                    for (int c = 0; c < client_site_sws_qty; c++)
+                    {
+                        f_sc_ij_obj_expr += f_sc_ij[s][c][i][j];
+                    }
+                }
+                // gamma_ij_obj_expr += gamma_ij[i][j]*( 1.2 - net_topo.b_ij[i][j]/net_topo.link_capacity[i][j] );
+                // gamma_ij_obj_expr += gamma_ij[i][j] * (2.0 - net_topo.b_ij[i][j] / net_topo.link_capacity[i][j]);
+                gamma_ij_obj_expr += gamma_ij[i][j];
+            }
+        }
+        // model.add(IloMinimize(env, -10 * exp_r_sc_obj + f_sc_ij_obj_expr));
+        model.add(IloMinimize(env, -10 * exp_r_sc_obj + f_sc_ij_obj_expr - gamma_ij_obj_expr));
+        // model.add(IloMinimize(env, -30 * exp_r_sc_obj + f_sc_ij_obj_expr - 2*gamma_ij_obj_expr /*- f_sc_gamma_ij_obj_expr*/));
+        f_sc_ij_obj_expr.end();
+        exp_r_sc_obj.end();
+        gamma_ij_obj_expr.end();
+
+        multiserverCplex.extract(model);
+        set_solver_params();
+    } // end of build()
+
+    int apply_deltas(const std::vector<Net_Topo::Topo_Delta> &deltas)
+    {
+        for (auto &delta : deltas)
+        {
+            if (net_topo.edge_index(delta.i, delta.j) < 0 || delta.i < net_topo.srv_qty || delta.j < net_topo.srv_qty)
+                continue;
+            gamma_ij[delta.i][delta.j].setUB(net_topo.capacity(delta.i, delta.j) / (double)10.0);
+        }
+        return update_bw_rhs();
+    }
+
+    void get_solution()
+    {
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                r_sc_sol[s][c] = multiserverCplex.getValue(r_sc[s][c]);
+            }
+            // cout << "r_sc[" << s << "]" << r_sc_sol[s] << "\n";
+        }
+
+        for (int i = net_topo.srv_qty; i < (net_topo.srv_qty + net_topo.sw_qty); i++)
+        {
+            for (int j = net_topo.srv_qty; j < net_topo.srv_qty + net_topo.sw_qty; j++)
+            {
+                if (net_topo.has_edge(i, j))
+                {
+                    gamma_ij_sol[i][j] = multiserverCplex.getValue(gamma_ij[i][j]);
+                    // if (gamma_ij_sol[i][j] > 0)
+                    // cout << "gamma_ij_sol[" << i << j << "]" << gamma_ij_sol[i][j] << "\n";
+                }
+            }
+        }
+
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                for (int i = net_topo.srv_qty; i < (net_topo.srv_qty + net_topo.sw_qty); i++)
+                {
+                    for (int j = net_topo.srv_qty; j < net_topo.srv_qty + net_topo.sw_qty; j++)
+                    {
+                        if (net_topo.has_edge(i, j))
+                        {
+                            f_sc_ij_sol[s][c][i][j] = multiserverCplex.getValue(f_sc_ij[s][c][i][j]);
+                            //  if (f_sc_ij_sol > 0)
+                            //  cout << "f_sc_ij_sol[" << s << c << i << j << "]" << f_sc_ij_sol << "\n";
+                        }
+                    }
+                }
+            }
+        }
+    }
+}; // end of class Multiserver_LP
+
+// Candidate paths of the path formulation, the k shortest loopless paths by hop count of each (sssw, cssw) pair (Yen's algorithm).
+// Paths go from x to y through sws that are neither server side nor client side, the sws the arc formulation keeps flows
+// conserved at. Paths are stored back to back as CSR edge indexes, like in Path_Table.
+struct Candidate_Paths
+{
+    std::vector<int> path_edges;
+    std::vector<int> path_offsets;      // path p is path_edges[path_offsets[p], path_offsets[p + 1])
+    std::vector<int> commodity_offsets; // paths of commodity (s, c) are [commodity_offsets[s * cssw_qty + c], commodity_offsets[s * cssw_qty + c + 1])
+    std::vector<int> path_sssw;         // s of each path
+    int cssw_qty = 0;
+
+    // search state, banned_sw and banned_edge hold the stamp of the spur search they're banned for
+    std::vector<int> banned_sw;
+    std::vector<int> banned_edge;
+    std::vector<int> prev_sw;
+    std::vector<int> prev_edge;
+    std::vector<int> seen;
+    std::vector<int> bfs_queue;
+    int stamp = 0;
+
+    Index_Range edges(int p) const
+    {
+        return {path_edges.data() + path_offsets[p], path_edges.data() + path_offsets[p + 1]};
+    }
+    int path_qty() const { return path_offsets.size() - 1; }
+
+    void build(Net_Topo &net_topo, int k)
+    {
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
+        cssw_qty = net_topo.ClientSideOFSWs.size();
+        path_edges.clear();
+        path_offsets.assign(1, 0);
+        path_sssw.clear();
+        commodity_offsets.assign(1, 0);
+        banned_sw.assign(net_topo.core_qty, 0);
+        banned_edge.assign(net_topo.edge_qty(), 0);
+        prev_sw.assign(net_topo.core_qty, -1);
+        prev_edge.assign(net_topo.core_qty, -1);
+        seen.assign(net_topo.core_qty, 0);
+        stamp = 0;
+
+        std::vector<std::vector<int>> found; // paths of the commodity, shortest first
+        auto shorter = [](const std::vector<int> &a, const std::vector<int> &b)
+        { return a.size() != b.size() ? a.size() < b.size() : a < b; };
+        std::set<std::vector<int>, decltype(shorter)> candidates(shorter);
+        std::vector<int> spur, root_sws;
+        for (int s = 0; s < sssw_qty; s++)
+        {
+            int x = s + net_topo.srv_qty;
+            for (int c = 0; c < cssw_qty; c++)
+            {
+                int y = c + net_topo.srv_qty + net_topo.OF_SWs.size();
+                found.clear();
+                candidates.clear();
+                stamp++;
+                if (shortest_path(net_topo, x, y, spur))
+                    found.emplace_back(spur);
+                while (!found.empty() && (int)found.size() < k)
+                {
+                    const std::vector<int> last = found.back();
+                    root_sws.assign(1, x);
+                    for (size_t r = 0; r < last.size(); r++) // spur from the r-th sw of the last path
+                    {
+                        stamp++;
+                        for (auto &path : found)
+                            if (path.size() > r && std::equal(last.begin(), last.begin() + r, path.begin()))
+                                banned_edge[path[r]] = stamp;
+                        for (size_t i = 0; i + 1 < root_sws.size(); i++)
+                            banned_sw[root_sws[i]] = stamp;
+                        if (shortest_path(net_topo, root_sws.back(), y, spur))
+                        {
+                            spur.insert(spur.begin(), last.begin(), last.begin() + r);
+                            if (std::find(found.begin(), found.end(), spur) == found.end())
+                                candidates.insert(spur);
+                        }
+                        root_sws.push_back(net_topo.col_idx[last[r]]);
+                    }
+                    if (candidates.empty())
+                        break;
+                    found.emplace_back(*candidates.begin());
+                    candidates.erase(candidates.begin());
+                }
+                for (auto &path : found)
+                {
+                    path_edges.insert(path_edges.end(), path.begin(), path.end());
+                    path_offsets.push_back(path_edges.size());
+                    path_sssw.push_back(s);
+                }
+                commodity_offsets.push_back(path_sssw.size());
+            }
+        }
+    }
+
+    // BFS from u to y skipping sws and edges banned for the current stamp, edges of the path are put in path
+    bool shortest_path(Net_Topo &net_topo, int u, int y, std::vector<int> &path)
+    {
+        bfs_queue.assign(1, u);
+        seen[u] = stamp;
+        for (size_t head = 0; head < bfs_queue.size() && seen[y] != stamp; head++)
+        {
+            int i = bfs_queue[head];
+            for (int e = net_topo.row_ptr[i]; e < net_topo.row_ptr[i + 1]; e++) // neighbours with their CSR edge
+            {
+                int j = net_topo.col_idx[e];
+                bool transit = j >= net_topo.srv_qty && !net_topo.server_side_sw[j] && !net_topo.client_side_sw[j];
+                if (seen[j] == stamp || banned_sw[j] == stamp || banned_edge[e] == stamp || (j != y && !transit))
+                    continue;
+                seen[j] = stamp;
+                prev_sw[j] = i;
+                prev_edge[j] = e;
+                if (j != y)
+                    bfs_queue.push_back(j);
+            }
+        }
+        bool reached = seen[y] == stamp;
+        stamp++; // seen marks of this search don't hold for the next one, bans are set again by the caller
+        if (!reached)
+            return false;
+        path.clear();
+        for (int v = y; v != u; v = prev_sw[v])
+            path.push_back(prev_edge[v]);
+        std::reverse(path.begin(), path.end());
+        return true;
+    }
+};
+
+// Path formulation of the multiserver LP (--lp-solver=paths). It has a rate variable for each candidate path instead of f_sc_ij
+// over the whole core grid, and a gamma variable for each sw to sw edge. Its objective is the arc formulation's: -10 per unit of
+// r_sc, 1 per unit of flow on each hop, -1 per unit of gamma. r_sc is the sum of its paths' rates. Flows are read as paths,
+// so f_sc_ij_sol isn't allocated and flow assignment takes the paths as they are.
+class Multiserver_Path_LP : public Multiserver_Live_LP
+{
+public:
+    Multiserver_Path_LP(Net_Topo &net_topo, int k) : Multiserver_Live_LP(net_topo)
+    {
+        auto build_start_time = std::chrono::steady_clock::now();
+        candidates.build(net_topo, k);
+        auto paths_time = std::chrono::steady_clock::now();
+        build();
+        allocate_results(net_topo, false);
+        build_time = std::chrono::steady_clock::now() - build_start_time;
+        cout << "multiserver path LP: " << candidates.path_qty() << " candidate paths (k = " << k << ") in "
+             << std::chrono::duration<double, std::milli>(paths_time - build_start_time).count() << " ms, built in " << build_time.count() << " ms\n";
+    }
+
+    Candidate_Paths candidates;
+    IloNumVarArray path_rate;           // rate of each candidate path
+    IloNumVarArray gamma_e;             // free capacity kept on each CSR edge against burst usage, unused for edges with a server end
+    std::vector<double> path_rate_sol;
+
+    void build()
+    {
+        path_rate = IloNumVarArray(env, candidates.path_qty(), 0, IloInfinity);
+        gamma_e = IloNumVarArray(env, net_topo.edge_qty(), 0, 0);
+        std::vector<IloExpr> edge_flow_exprs(net_topo.edge_qty());
+        std::vector<IloExpr> sssw_rate_exprs(server_site_sws_qty);
+        IloExpr obj_expr(env);
+        for (int p = 0; p < candidates.path_qty(); p++)
+        {
+            auto edges = candidates.edges(p);
+            obj_expr += (edges.size() - 10.0) * path_rate[p];
+            for (int k : edges)
+            {
+                if (!edge_flow_exprs[k].getImpl())
+                    edge_flow_exprs[k] = IloExpr(env);
+                edge_flow_exprs[k] += path_rate[p];
+            }
+            int s = candidates.path_sssw[p];
+            if (!sssw_rate_exprs[s].getImpl())
+                sssw_rate_exprs[s] = IloExpr(env);
+            sssw_rate_exprs[s] += path_rate[p];
+        }
+
+        //The constraint, upper bound according to x's connections
+        sssw_rate_ranges.resize(server_site_sws_qty);
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            if (!sssw_rate_exprs[s].getImpl())
+                continue;
+            sssw_rate_ranges[s] = (sssw_rate_exprs[s] <= bit_rate_of_x(s + net_topo.srv_qty));
+            model.add(sssw_rate_ranges[s]);
+            sssw_rate_exprs[s].end();
+        }
+
+        // BW limitation, edges no path uses have a row for their gamma only
+        edge_bw_ranges.assign(net_topo.edge_qty(), IloRange());
+        applied_bw.assign(net_topo.edge_qty(), 0.0);
+        for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+        {
+            for (int j : net_topo.neighbours(i))
+            {
+                int k = net_topo.edge_index(i, j);
+                if (j < net_topo.srv_qty)
+                    continue;
+                gamma_e[k].setUB(net_topo.edge_capacity[k] / (double)10.0); // If there is enough capacity, it tries to keep 10% of the link capacity free against burst usage
+                obj_expr -= gamma_e[k];
+                applied_bw[k] = net_topo.available_bw(i, j);
+                if (!edge_flow_exprs[k].getImpl())
+                    edge_flow_exprs[k] = IloExpr(env);
+                edge_bw_ranges[k] = (edge_flow_exprs[k] + gamma_e[k] <= applied_bw[k]);
+                model.add(edge_bw_ranges[k]);
+                edge_flow_exprs[k].end();
+            }
+        }
+        model.add(IloMinimize(env, obj_expr));
+        obj_expr.end();
+
+        multiserverCplex.extract(model);
+        set_solver_params();
+    }
+
+    int apply_deltas(const std::vector<Net_Topo::Topo_Delta> &deltas)
+    {
+        for (auto &delta : deltas)
+        {
+            int k = net_topo.edge_index(delta.i, delta.j);
+            if (k < 0 || delta.i < net_topo.srv_qty || delta.j < net_topo.srv_qty)
+                continue;
+            gamma_e[k].setUB(net_topo.capacity(delta.i, delta.j) / (double)10.0);
+        }
+        return update_bw_rhs();
+    }
+
+    void get_solution()
+    {
+        IloNumArray values(env);
+        multiserverCplex.getValues(values, path_rate);
+        path_rate_sol.assign(candidates.path_qty(), 0.0);
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                int commodity = s * client_site_sws_qty + c;
+                r_sc_sol[s][c] = 0;
+                for (int p = candidates.commodity_offsets[commodity]; p < candidates.commodity_offsets[commodity + 1]; p++)
+                {
+                    path_rate_sol[p] = values[p];
+                    r_sc_sol[s][c] += values[p];
+                }
+            }
+        }
+        multiserverCplex.getValues(values, gamma_e);
+        for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+        {
+            for (int j : net_topo.neighbours(i))
+            {
+                if (j >= net_topo.srv_qty)
+                    gamma_ij_sol[i][j] = values[net_topo.edge_index(i, j)];
+            }
+        }
+        values.end();
+    }
+
+    void clear_solution()
+    {
+        clear_results(net_topo);
+        path_rate_sol.assign(candidates.path_qty(), 0.0);
+    }
+}; // end of class Multiserver_Path_LP
+
+// updates provided_rate_for_c vector
+void set_provided_rate_for_c(Net_Topo &net_topo, IloNumArray2 &r_sc_sol, vector<double> &provided_rate_for_c)
+{
+    int cssw_qty = net_topo.ClientSideOFSWs.size();
+    int sssw_qty = net_topo.ServerSideOFSWs.size();
+
+    for (int c = 0; c < cssw_qty; c++)
+    {
+        provided_rate_for_c[c] = 0;
+    }
+
+    for (int s = 0; s < sssw_qty; s++)
+    {
+        for (int c = 0; c < cssw_qty; c++)
+        {
+            provided_rate_for_c[c] += r_sc_sol[s][c];
+        }
+    }
+}
+
+// applies pending topology deltas and changed avaiable bw to the live multiserver LP, solves it and writes its results to multiserver_lp's result arrays
+void multiserver(Multiserver_Live_LP &multiserver_lp, Net_Topo &net_topo, const Demand_Model &b_bar_cl, int m_c, vector<double> &provided_rate_for_c, bool retried = false)
+{
+    IloCplex &multiserverCplex = multiserver_lp.multiserverCplex;
+    IloNumArray2 &r_sc_sol = multiserver_lp.r_sc_sol;
+
+    auto patch_start_time = std::chrono::steady_clock::now();
+    net_topo.apply_link_events();
+    std::vector<Net_Topo::Topo_Delta> deltas = net_topo.take_deltas();
+    int changed_rows = multiserver_lp.apply_deltas(deltas);
+    auto solve_start_time = std::chrono::steady_clock::now();
+    IloBool solved = multiserver_lp.solve();
+    std::chrono::duration<double, std::milli> patch_time = solve_start_time - patch_start_time;
+    std::chrono::duration<double, std::milli> solve_time = std::chrono::steady_clock::now() - solve_start_time;
+    multiserver_runtimes.emplace_back(std::chrono::steady_clock::now() - patch_start_time);
+    cout << "multiserver LP: " << changed_rows << " rows patched in " << patch_time.count() << " ms, solved in " << solve_time.count() << " ms (build " << multiserver_lp.build_time.count() << " ms)\n";
+
+    if (solved)
+    {
+        // multiserverCplex.exportModel("multiServerModel.lp"); // writes the whole model at every cycle, enable only for debugging
+        IloAlgorithm::Status solStatus = multiserverCplex.getStatus();
+        // cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!multiserver Status: " << solStatus << "\n";
+        multiserver_lp.get_solution();
+    }
+    else
+    {
+        cout << "multiserver LP has no solution: " << multiserverCplex.getStatus() << ", no rate is given this cycle\n";
+        multiserver_lp.clear_solution(); // results of the previous cycle aren't valid for this topology
+    }
+
+    set_provided_rate_for_c(net_topo, r_sc_sol, provided_rate_for_c);
+    int cssw_qty = net_topo.ClientSideOFSWs.size();
+    for (int c = 0; c < cssw_qty; c++)
+    {
+        if (provided_rate_for_c[c] == 0 && !retried) // the live model gives the same result, so it's solved again only once
+        {
+            cout << "---!!! Multiserver() called again\n";
+            multiserver(multiserver_lp, net_topo, b_bar_cl, m_c, provided_rate_for_c, true);
+            break;
+        }
+    }
+
+} // End of multiserver function
+
+// In-process min cost flow engine for the multiserver stage (--lp-solver=native), it doesn't need CPLEX.
+// All sssws are fed by a super source whose arcs cost -10 (the r_sc gain) and all cssws drain to a super sink. Each sw to sw
+// edge is split into an arc of max(0, b - cap/10) at cost 1 and an arc of min(cap/10, b) at cost 2, because flow using the gamma
+// headroom also loses its -gamma gain. Successive shortest paths augment while the path cost is negative, then the aggregated
+// flow is decomposed into sssw -> cssw paths to fill r_sc_sol and f_sc_ij_sol.
+// With one sssw it gives the LP's optimum. The LP has no conservation rows at other sssws, so with several sssws it can end flows
+// there, while this engine ends flows only at cssws.
+class Multiserver_Native : public Multiserver_Results
+{
+public:
+    Multiserver_Native(Net_Topo &net_topo) : net_topo(net_topo)
+    {
+        allocate_results(net_topo);
+    }
+
+    struct Arc
+    {
+        int to;
+        int rev;     // index of reverse arc in arcs[to]
+        double cap;  // residual capacity
+        double cost;
+        int edge;    // CSR edge index, -1 for super source/sink arcs
+    };
+
+    Net_Topo &net_topo;
+    std::vector<std::vector<Arc>> arcs; // residual graph, core indexes + super source + super sink
+    std::vector<double> edge_flow;      // aggregated flow on each CSR edge
+    double r_gain = 10.0;               // r_sc weight in the LP objective
+    double eps = 1e-9;
+
+    void add_arc(int from, int to, double cap, double cost, int edge)
+    {
+        if (cap <= eps)
+            return;
+        arcs[from].push_back({to, (int)arcs[to].size(), cap, cost, edge});
+        arcs[to].push_back({from, (int)arcs[from].size() - 1, 0.0, -cost, -1});
+    }
+
+    void build_residual_graph(int source, int sink)
+    {
+        arcs.assign(net_topo.core_qty + 2, std::vector<Arc>());
+        for (int x : net_topo.ServerSideOFSWs)
+        {
+            double bit_rate = 0.0; // same bound as the LP's rate row of x
+            for (auto j : net_topo.Server_OF_SWs_Connections[x])
+            {
+                bit_rate += net_topo.available_bw(x, j);
+            }
+            add_arc(source, x, bit_rate, -r_gain, -1);
+        }
+        for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+        {
+            if (net_topo.client_side_sw[i]) // flows end at the first cssw
+                continue;
+            for (int j : net_topo.neighbours(i))
+            {
+                if (j < net_topo.srv_qty || (net_topo.server_side_sw[i] && net_topo.server_side_sw[j]))
+                    continue;
+                int k = net_topo.edge_index(i, j);
+                double b = net_topo.edge_b[k];
+                double headroom = net_topo.edge_capacity[k] / 10.0;
+                add_arc(i, j, std::max(0.0, b - headroom), 1.0, k);
+                add_arc(i, j, std::min(headroom, b), 2.0, k);
+            }
+        }
+        for (int y : net_topo.ClientSideOFSWs)
+        {
+            add_arc(y, sink, std::numeric_limits<double>::infinity(), 0.0, -1);
+        }
+    }
+
+    bool solve()
+    {
+        int source = net_topo.core_qty;
+        int sink = net_topo.core_qty + 1;
+        int node_qty = net_topo.core_qty + 2;
+        build_residual_graph(source, sink);
+
+        // successive shortest paths, SPFA since residual arcs have negative costs
+        std::vector<double> dist(node_qty);
+        std::vector<int> prev_node(node_qty), prev_arc(node_qty);
+        std::vector<bool> in_queue(node_qty);
+        while (true)
+        {
+            std::fill(dist.begin(), dist.end(), std::numeric_limits<double>::infinity());
+            std::fill(prev_node.begin(), prev_node.end(), -1);
+            std::queue<int> spfa_queue;
+            dist[source] = 0;
+            spfa_queue.push(source);
+            in_queue[source] = true;
+            while (!spfa_queue.empty())
+            {
+                int u = spfa_queue.front();
+                spfa_queue.pop();
+                in_queue[u] = false;
+                for (int a = 0; a < (int)arcs[u].size(); a++)
+                {
+                    Arc &arc = arcs[u][a];
+                    if (arc.cap > eps && dist[u] + arc.cost < dist[arc.to] - eps)
+                    {
+                        dist[arc.to] = dist[u] + arc.cost;
+                        prev_node[arc.to] = u;
+                        prev_arc[arc.to] = a;
+                        if (!in_queue[arc.to])
+                        {
+                            spfa_queue.push(arc.to);
+                            in_queue[arc.to] = true;
+                        }
+                    }
+                }
+            }
+            if (prev_node[sink] < 0 || dist[sink] >= -eps) // no more profitable path
+                break;
+
+            double bottleneck = std::numeric_limits<double>::infinity();
+            for (int v = sink; v != source; v = prev_node[v])
+            {
+                bottleneck = std::min(bottleneck, arcs[prev_node[v]][prev_arc[v]].cap);
+            }
+            for (int v = sink; v != source; v = prev_node[v])
+            {
+                Arc &arc = arcs[prev_node[v]][prev_arc[v]];
+                arc.cap -= bottleneck;
+                arcs[v][arc.rev].cap += bottleneck;
+            }
+        }
+
+        // aggregated flow of each edge is the residual capacity of reverse arcs
+        edge_flow.assign(net_topo.edge_qty(), 0.0);
+        std::vector<double> sssw_flow(net_topo.ServerSideOFSWs.size(), 0.0);
+        for (int u = 0; u < node_qty; u++)
+        {
+            for (auto &arc : arcs[u])
+            {
+                if (arc.edge >= 0)
+                    edge_flow[arc.edge] += arcs[arc.to][arc.rev].cap;
+                else if (u == source)
+                    sssw_flow[arc.to - net_topo.srv_qty] += arcs[arc.to][arc.rev].cap;
+            }
+        }
+
+        set_gamma_ij_sol();
+        decompose_flows(sssw_flow);
+        return true;
+    }
+
+    // headroom left on each sw to sw edge, gamma_ij = min(cap/10, b - f)
+    void set_gamma_ij_sol()
+    {
+        for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+        {
+            for (int j = net_topo.srv_qty; j < net_topo.core_qty; j++)
+            {
+                gamma_ij_sol[i][j] = 0;
+            }
+            for (int j : net_topo.neighbours(i))
+            {
+                if (j < net_topo.srv_qty)
+                    continue;
+                int k = net_topo.edge_index(i, j);
+                gamma_ij_sol[i][j] = std::max(0.0, std::min(net_topo.edge_capacity[k] / 10.0, net_topo.edge_b[k] - edge_flow[k]));
+            }
+        }
+    }
+
+    // splits the aggregated flow into paths from each sssw, a path ending at cssw c adds to r_sc_sol[s][c] and f_sc_ij_sol[s][c]
+    void decompose_flows(std::vector<double> &sssw_flow)
+    {
+        int server_site_sws_qty = net_topo.ServerSideOFSWs.size();
+        int client_site_sws_qty = net_topo.ClientSideOFSWs.size();
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            for (int c = 0; c < client_site_sws_qty; c++)
+            {
+                r_sc_sol[s][c] = 0;
+                for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+                {
+                    for (int j = net_topo.srv_qty; j < net_topo.core_qty; j++)
+                    {
+                        f_sc_ij_sol[s][c][i][j] = 0;
+                    }
+                }
+            }
+        }
+
+        std::vector<int> path; // CSR edges of current path
+        for (int s = 0; s < server_site_sws_qty; s++)
+        {
+            while (sssw_flow[s] > eps)
+            {
+                path.clear();
+                double amount = sssw_flow[s];
+                int current_sw = s + net_topo.srv_qty;
+                while (!net_topo.client_side_sw[current_sw] && (int)path.size() < net_topo.core_qty)
+                {
+                    int next_edge = -1;
+                    for (int j : net_topo.neighbours(current_sw))
+                    {
+                        int k = net_topo.edge_index(current_sw, j);
+                        if (edge_flow[k] > eps)
+                        {
+                            next_edge = k;
+                            current_sw = j;
+                            break;
+                        }
+                    }
+                    if (next_edge < 0)
+                        break;
+                    path.push_back(next_edge);
+                    amount = std::min(amount, edge_flow[next_edge]);
+                }
+                if (!net_topo.client_side_sw[current_sw]) // only rounding leftovers can stop here
+                    break;
+
+                int c = current_sw - net_topo.srv_qty - net_topo.OF_SWs.size();
+                r_sc_sol[s][c] += amount;
+                sssw_flow[s] -= amount;
+                int i = s + net_topo.srv_qty;
+                for (int k : path)
+                {
+                    int j = net_topo.col_idx[k];
+                    f_sc_ij_sol[s][c][i][j] += amount;
+                    edge_flow[k] -= amount;
+                    i = j;
+                }
+            }
+        }
+    }
+}; // end of class Multiserver_Native
+
+// multiserver stage solved by Multiserver_Native, it reads avaiable bw from net_topo directly so pending deltas are only dropped
+void multiserver_native(Multiserver_Native &multiserver_native_engine, Net_Topo &net_topo, vector<double> &provided_rate_for_c)
+{
+    auto solve_start_time = std::chrono::steady_clock::now();
+    net_topo.apply_link_events();
+    net_topo.take_deltas();
+    multiserver_native_engine.solve();
+    std::chrono::duration<double, std::milli> solve_time = std::chrono::steady_clock::now() - solve_start_time;
+    multiserver_runtimes.emplace_back(std::chrono::steady_clock::now() - solve_start_time);
+    cout << "multiserver native flow engine solved in " << solve_time.count() << " ms\n";
+
+    set_provided_rate_for_c(net_topo, multiserver_native_engine.r_sc_sol, provided_rate_for_c);
+}
+
+// Applies posted link events and re-solves the multiserver stage at once instead of at the next cycle. Called by the solve stage
+// while it waits for its cycle. Returns false if no event was posted.
+bool react_to_link_events(Net_Topo &net_topo, Multiserver_Live_LP *multiserver_lp, Multiserver_Native *multiserver_native_engine, const Demand_Model &b_bar_cl,
+                          int m_c, vector<double> &provided_rate_for_c)
+{
+    auto oldest_event = net_topo.apply_link_events();
+    if (!oldest_event)
+        return false;
+    if (multiserver_lp)
+        multiserver(*multiserver_lp, net_topo, b_bar_cl, m_c, provided_rate_for_c);
+    else
+        multiserver_native(*multiserver_native_engine, net_topo, provided_rate_for_c);
+    link_event_reactions.emplace_back(std::chrono::steady_clock::now() - *oldest_event);
+    cout << "link events applied and multiserver re-solved " << link_event_reactions.back().count() * 1000 << " ms after they were posted\n";
+    return true;
+}
+
+// Paths of the multiserver flows, decomposed from f_sc_ij_sol once per cycle. Each (sssw, cssw) commodity's flow is split into
+// weighted paths, then client layers are packed onto them, so flow assignment doesn't search hops per client.
+// Paths are stored back to back as CSR edge indexes.
+struct Path_Table
+{
+    struct Path
+    {
+        int first;        // path's edges are path_edges[first, last)
+        int last;
+        double remaining; // flow of path not yet assigned to layers
+    };
+    std::vector<int> path_edges;
+    std::vector<Path> paths;
+    std::vector<int> commodity_offsets; // paths of commodity (s, c) are paths[commodity_offsets[s * cssw_qty + c], commodity_offsets[s * cssw_qty + c + 1])
+    int cssw_qty = 0;
+
+    std::vector<double> flow;     // flow of the commodity being decomposed, per CSR edge
+    std::vector<int> path_pos;    // position of a sw on the current walk, -1 if not on it
+    std::vector<int> walk_sws;
+    std::vector<int> walk_edges;
+
+    Index_Range edges(int p) const
+    {
+        return {path_edges.data() + paths[p].first, path_edges.data() + paths[p].last};
+    }
+
+    void build(Net_Topo &net_topo, IloNumArray4 &f_sc_ij_sol, double eps = 1e-6)
+    {
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
+        cssw_qty = net_topo.ClientSideOFSWs.size();
+        path_edges.clear();
+        paths.clear();
+        commodity_offsets.assign(1, 0);
+        path_pos.assign(net_topo.core_qty, -1);
+
+        for (int s = 0; s < sssw_qty; s++)
+        {
+            for (int c = 0; c < cssw_qty; c++)
+            {
+                flow.assign(net_topo.edge_qty(), 0.0);
+                for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+                {
+                    for (int j : net_topo.neighbours(i))
+                    {
+                        if (j >= net_topo.srv_qty)
+                            flow[net_topo.edge_index(i, j)] = f_sc_ij_sol[s][c][i][j];
+                    }
+                }
+                decompose(net_topo, s + net_topo.srv_qty, c + net_topo.srv_qty + net_topo.OF_SWs.size(), eps);
+                commodity_offsets.push_back(paths.size());
+            }
+        }
+    }
+
+    // walks flow from x until y. Cycles met on the walk are cancelled, walks ending elsewhere than y are dropped.
+    void decompose(Net_Topo &net_topo, int x, int y, double eps)
+    {
+        while (true)
+        {
+            walk_sws.assign(1, x);
+            walk_edges.clear();
+            path_pos[x] = 0;
+            int current_sw = x;
+            while (current_sw != y)
+            {
+                int next_edge = -1;
+                for (int j : net_topo.neighbours(current_sw))
+                {
+                    int k = net_topo.edge_index(current_sw, j);
+                    if (flow[k] > eps)
+                    {
+                        next_edge = k;
+                        break;
+                    }
+                }
+                if (next_edge < 0)
+                    break;
+                int next_sw = net_topo.col_idx[next_edge];
+                walk_edges.push_back(next_edge);
+                if (path_pos[next_sw] >= 0) // cycle, its flow doesn't reach y
+                {
+                    int cycle_first = path_pos[next_sw];
+                    double cycle_flow = flow[next_edge];
+                    for (int e = cycle_first; e < (int)walk_edges.size(); e++)
+                        cycle_flow = std::min(cycle_flow, flow[walk_edges[e]]);
+                    for (int e = cycle_first; e < (int)walk_edges.size(); e++)
+                        flow[walk_edges[e]] -= cycle_flow;
+                    for (int e = cycle_first + 1; e < (int)walk_sws.size(); e++)
+                        path_pos[walk_sws[e]] = -1;
+                    walk_sws.resize(cycle_first + 1);
+                    walk_edges.resize(cycle_first);
+                    current_sw = next_sw;
+                    continue;
+                }
+                path_pos[next_sw] = walk_sws.size();
+                walk_sws.push_back(next_sw);
+                current_sw = next_sw;
+            }
+            for (int sw : walk_sws)
+                path_pos[sw] = -1;
+            if (current_sw != y || walk_edges.empty())
+            {
+                if (walk_edges.empty())
+                    return; // no flow left from x
+                // the walk ended before y, drop its flow so that the next walk takes another branch
+                double dropped = flow[walk_edges[0]];
+                for (int k : walk_edges)
+                    dropped = std::min(dropped, flow[k]);
+                for (int k : walk_edges)
+                    flow[k] -= dropped;
+                continue;
+            }
+
+            double path_flow = flow[walk_edges[0]];
+            for (int k : walk_edges)
+                path_flow = std::min(path_flow, flow[k]);
+            for (int k : walk_edges)
+                flow[k] -= path_flow;
+            paths.push_back({(int)path_edges.size(), (int)(path_edges.size() + walk_edges.size()), path_flow});
+            path_edges.insert(path_edges.end(), walk_edges.begin(), walk_edges.end());
+        }
+    }
+
+    // paths of the path formulation with their rates, they need no decomposition
+    void assign(const Candidate_Paths &candidates, const std::vector<double> &path_rates, double eps = 1e-6)
+    {
+        cssw_qty = candidates.cssw_qty;
+        path_edges.clear();
+        paths.clear();
+        commodity_offsets.assign(1, 0);
+        for (size_t commodity = 0; commodity + 1 < candidates.commodity_offsets.size(); commodity++)
+        {
+            for (int p = candidates.commodity_offsets[commodity]; p < candidates.commodity_offsets[commodity + 1]; p++)
+            {
+                if (path_rates[p] <= eps)
+                    continue;
+                auto edges = candidates.edges(p);
+                paths.push_back({(int)path_edges.size(), (int)path_edges.size() + edges.size(), path_rates[p]});
+                path_edges.insert(path_edges.end(), edges.begin(), edges.end());
+            }
+            commodity_offsets.push_back(paths.size());
+        }
+    }
+
+    // first path of commodity (s, c) which still has room for demand, -1 if none. Demand is taken from the path.
+    int first_fit(int s, int c, double demand)
+    {
+        int commodity = s * cssw_qty + c;
+        for (int p = commodity_offsets[commodity]; p < commodity_offsets[commodity + 1]; p++)
+        {
+            if (paths[p].remaining - demand >= 0.0)
+            {
+                paths[p].remaining -= demand;
+                return p;
+            }
+        }
+        return -1;
+    }
+};
+
+// Fixed set of worker threads for data parallel loops of the master engines. parallel_for splits [0, n) into one chunk per worker
+// and returns when all chunks are done, fn gets the worker index so that it can use per-worker accumulators.
+class Thread_Pool
+{
+public:
+    explicit Thread_Pool(int thread_qty)
+    {
+        thread_qty = std::max(1, thread_qty);
+        for (int w = 0; w < thread_qty; w++)
+            workers.emplace_back(&Thread_Pool::work, this, w);
+    }
+    ~Thread_Pool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_cv.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    int size() const
+    {
+        return workers.size();
+    }
+
+    void parallel_for(int n, const std::function<void(int worker, int begin, int end)> &fn)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job = &fn;
+        job_size = n;
+        pending = workers.size();
+        generation++;
+        work_cv.notify_all();
+        done_cv.wait(lock, [this]
+                     { return pending == 0; });
+        job = nullptr;
+    }
+
+    // runs fn(worker, task) for tasks [0, task_qty) of uneven sizes. Tasks are dealt to per-worker queues, a worker takes from the
+    // back of its own queue and steals from the front of the others' when it's empty.
+    void run_tasks(int task_qty, const std::function<void(int worker, int task)> &fn)
+    {
+        int worker_qty = workers.size();
+        std::vector<std::deque<int>> queues(worker_qty);
+        std::vector<std::mutex> queue_mutexes(worker_qty);
+        for (int task = 0; task < task_qty; task++)
+            queues[task % worker_qty].push_back(task);
+        parallel_for(worker_qty, [&](int w, int, int)
+                     {
+                         while (true)
+                         {
+                             int task = -1;
+                             for (int i = 0; i < worker_qty && task < 0; i++)
+                             {
+                                 int victim = (w + i) % worker_qty;
+                                 std::unique_lock<std::mutex> lock(queue_mutexes[victim]);
+                                 if (queues[victim].empty())
+                                     continue;
+                                 if (victim == w)
+                                 {
+                                     task = queues[victim].back();
+                                     queues[victim].pop_back();
+                                 }
+                                 else
+                                 {
+                                     task = queues[victim].front();
+                                     queues[victim].pop_front();
+                                 }
+                             }
+                             if (task < 0)
+                                 return;
+                             fn(w, task);
+                         } });
+    }
+
+private:
+    void work(int w)
+    {
+        int seen_generation = 0;
+        while (true)
+        {
+            const std::function<void(int, int, int)> *fn;
+            int n;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_cv.wait(lock, [&]
+                             { return stopping || generation != seen_generation; });
+                if (stopping)
+                    return;
+                seen_generation = generation;
+                fn = job;
+                n = job_size;
+            }
+            long long thread_qty = workers.size();
+            (*fn)(w, n * w / thread_qty, n * (w + 1) / thread_qty);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done_cv.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    const std::function<void(int, int, int)> *job = nullptr;
+    int job_size = 0;
+    int pending = 0;
+    int generation = 0;
+    bool stopping = false;
+};
+
+// Bounded hand-off queue between the stage threads of optimizer(). push() waits while it's full, pop() waits while it's empty,
+// both return false after close().
+template <typename T>
+class Stage_Queue
+{
+public:
+    explicit Stage_Queue(size_t capacity) : capacity(capacity) {}
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]
+                      { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // doesn't wait, false if it's full or closed
+    bool try_push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed || items.size() >= capacity)
+            return false;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // items pushed before close() are still popped
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]
+                       { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    // doesn't wait, false if it's empty
+    bool try_pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    bool is_closed()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return closed;
+    }
+
+    void close()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+};
+
+// runs stop when the scope is left
+struct Stage_Guard
+{
+    std::function<void()> stop;
+    ~Stage_Guard() { stop(); }
+};
+
+// Time budgets of an optimization cycle. Each cycle has an absolute publish deadline (cycle start + interval - publish margin).
+// Stage times are tracked as EWMA of mean and deviation (mean + 2 * deviation is used, like TCP's RTO), so the master MILP
+// gets what remains until the deadline minus the estimated flow assignment time, and budgets follow the load.
+// The publish stage thread records flow assignment and finishes its cycle while the solve stage asks for the next master deadline.
+class Deadline_Scheduler
+{
+public:
+    enum Stage
+    {
+        multiserver_stage,
+        master_stage,
+        flow_assignment_stage,
+        stage_qty
+    };
+
+    Deadline_Scheduler(int interval_ms, double publish_margin_ms = 50, double alpha = 0.25)
+        : interval_ms(interval_ms), publish_margin_ms(publish_margin_ms), alpha(alpha) {}
+
+    std::chrono::steady_clock::time_point start_cycle(std::chrono::steady_clock::time_point cycle_start)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        deadline = cycle_start + std::chrono::microseconds((long long)((interval_ms - publish_margin_ms) * 1000));
+        return deadline;
+    }
+
+    // extra is time of the stage spent before stage_start, e.g. path packing of the flow assignment in the solve stage
+    void record(Stage stage, std::chrono::steady_clock::time_point stage_start, std::chrono::duration<double> extra = std::chrono::duration<double>(0))
+    {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stage_start + extra).count();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (samples[stage]++ == 0)
+        {
+            mean_ms[stage] = ms;
+            dev_ms[stage] = ms / 2;
+            return;
+        }
+        dev_ms[stage] = (1 - alpha) * dev_ms[stage] + alpha * std::abs(ms - mean_ms[stage]);
+        mean_ms[stage] = (1 - alpha) * mean_ms[stage] + alpha * ms;
+    }
+
+    double estimate_ms(Stage stage) const
+    {
+        return mean_ms[stage] + 2 * dev_ms[stage];
+    }
+
+    // master has to stop at this point to publish flows and messages in time
+    std::chrono::steady_clock::time_point master_deadline()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return deadline - std::chrono::microseconds((long long)(estimate_ms(flow_assignment_stage) * 1000));
+    }
+
+    // called after flows and messages of the cycle with cycle_deadline are sent
+    void finish_cycle(std::chrono::steady_clock::time_point cycle_deadline)
+    {
+        double slack_ms = std::chrono::duration<double, std::milli>(cycle_deadline - std::chrono::steady_clock::now()).count();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (slack_ms < 0)
+            missed_deadlines++;
+        cout << "deadline: " << (slack_ms < 0 ? "missed by " : "met with ") << std::abs(slack_ms) << " ms slack, " << missed_deadlines
+             << " missed so far (est. multiserver " << estimate_ms(multiserver_stage) << " ms, master " << estimate_ms(master_stage)
+             << " ms, flow assignment " << estimate_ms(flow_assignment_stage) << " ms)\n";
+    }
+
+    int interval_ms;
+    double publish_margin_ms;
+    double alpha;
+    std::chrono::steady_clock::time_point deadline;
+    double mean_ms[stage_qty] = {};
+    double dev_ms[stage_qty] = {};
+    int samples[stage_qty] = {};
+    int missed_deadlines = 0;
+    std::mutex mutex;
+};
+
+// Results of the master stage. They're allocated once and overwritten at each solve, like Multiserver_Results
+struct Master_Results
+{
+    Master_Results(int requests_qty, int m_c, int srv_qty)
+    {
+        w_s_cl_sol = IloNumArray3(env, requests_qty); // result of optimization of w_s_cl
+        for (int i = 0; i < requests_qty; i++)
+        {
+            w_s_cl_sol[i] = IloNumArray2(env, m_c);
+            for (int j = 0; j < m_c; j++)
+            {
+                w_s_cl_sol[i][j] = IloNumArray(env, srv_qty);
+            }
+        }
+        v_c_sol = IloIntArray(env, requests_qty); // stores v_c result to use it in v_bar_c for next optimizations.
+    }
+    ~Master_Results()
+    {
+        env.end();
+    }
+
+    // seconds left for the master's solve, 1 s if optimizer didn't set a deadline
+    double time_budget() const
+    {
+        if (solve_deadline == std::chrono::steady_clock::time_point())
+            return 1.0;
+        double left = std::chrono::duration<double>(solve_deadline - std::chrono::steady_clock::now()).count();
+        return std::max(left, min_time_budget);
+    }
+
+    IloEnv env;
+    IloNumArray3 w_s_cl_sol;
+    IloIntArray v_c_sol;
+    std::chrono::steady_clock::time_point solve_deadline; // set at each cycle by Deadline_Scheduler
+    double min_time_budget = 0.05;                        // a late cycle still gets a short solve rather than no assignment
+
+    // no layer and no switch, used when master fails so that the previous segment's assignment isn't published again
+    void clear_solution()
+    {
+        for (int i = 0; i < w_s_cl_sol.getSize(); i++)
+        {
+            for (int j = 0; j < w_s_cl_sol[i].getSize(); j++)
+            {
+                for (int k = 0; k < w_s_cl_sol[i][j].getSize(); k++)
+                    w_s_cl_sol[i][j][k] = 0;
+            }
+            v_c_sol[i] = 0;
+        }
+    }
+};
+
+// MILP-free layer selection for master, near-linear in the client qty. Layers fixed by the pre-assignment of non-last sssws are
+// kept, the other layers come from a server of the cssw's last sssw within r_sc of that sssw, like master's rate rows.
+// 1. every client gets its base and fixed layers (constraints 0 and 3),
+// 2. the quality floor (Q, constraint 4) is raised level by level while each cssw has capacity and the objective drops,
+// 3. clients below l_bar_c move back toward it by best objective gain per rate (I_c and N_c of constraints 6 and 7),
+// 4. in the first segment switches don't count, so left capacity goes to the cheapest next layers.
+// lower_bound is the continuous relaxation of master with capacity kept only for the floor: every q_c >= t, t at most the
+// largest fractional floor each cssw can carry, a_c >= t - l_bar_c and v_c >= a_c / m_c.
+class Greedy_Master
+{
+public:
+    Greedy_Master(Net_Topo &net_topo, int m_c) : net_topo(net_topo), m_c(m_c) {}
+    virtual ~Greedy_Master() {}
+
+    Net_Topo &net_topo;
+    int m_c;
+    std::vector<int> quality;      // q_c
+    std::vector<int> layer_server; // [c * m_c + l], server of layer l of c, -1 if not given
+    double objective = 0;
+    double lower_bound = 0;
+    bool feasible = false;
+    std::chrono::duration<double, std::milli> solve_time;
+
+    // filled by prepare()
+    bool first_segment = true;
+    int I_max = 0; // same normalizers as master
+    int N_max = 0;
+    std::vector<double> layer_cost; // [c * m_c + l], rate of layer l of c on its last sssw, 0 if fixed, -1 if it can't be given
+    std::vector<int> min_q;         // base and fixed layers
+    std::vector<int> max_q;         // layers below max_q can be given
+    std::vector<double> capacity;   // r_sc of each cssw's last sssw
+    double time_budget = 1.0;       // seconds, set by master_greedy, iterative engines stop at it
+
+    // (3 * I_c + 7 * N_c) * requests_qty of quality q
+    double switch_cost(int c, int q) const
+    {
+        if (first_segment)
+            return 0.0;
+        int switch_size = std::abs(q - l_bar_c[c]);
+        return 3.0 * (mu_bar_c[c] + switch_size) / I_max + 7.0 * (v_bar_c[c] + (switch_size > 0 ? 1 : 0)) / N_max;
+    }
+
+    double objective_of(const std::vector<int> &q) const
+    {
+        int floor_q = m_c;
+        double switch_sum = 0;
+        for (int c = 0; c < net_topo.requests_qty; c++)
+        {
+            floor_q = std::min(floor_q, q[c]);
+            switch_sum += switch_cost(c, q[c]);
+        }
+        return 30.0 * (1.0 - floor_q / (double)m_c) + switch_sum / net_topo.requests_qty;
+    }
+
+    // rate of layers between quality from and to of c
+    double rate_between(int c, int from, int to) const
+    {
+        double rate = 0;
+        for (int l = from; l < to; l++)
+            rate += layer_cost[c * m_c + l];
+        return rate;
+    }
+
+    // w_fixed[(c * m_c + l) * srv_qty + s]: 1 = fixed to s, 0 = forbidden, -1 = free
+    // Picks the server of every layer and sets quality to min_q. Returns false if base or fixed layers don't fit.
+    bool prepare(const Demand_Model &b_bar_cl, IloNumArray2 &r_sc_sol, const std::vector<int> &w_fixed, const std::vector<int> &last_sssw_of_cssw, int segment_index)
+    {
+        int requests_qty = net_topo.requests_qty;
+        int srv_qty = net_topo.srv_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        first_segment = segment_index == 0;
+        lower_bound = -IloInfinity;
+
+        I_max = 0;
+        N_max = 0;
+        for (int c = 0; c < requests_qty; c++)
+        {
+            I_max = std::max(I_max, mu_bar_c[c] + m_c);
+            N_max = std::max(N_max, v_bar_c[c]);
+        }
+        N_max += 1;
+
+        quality.assign(requests_qty, 0);
+        layer_server.assign(requests_qty * m_c, -1);
+        layer_cost.assign(requests_qty * m_c, -1);
+        max_q.assign(requests_qty, 0);
+        std::vector<size_t> next_server(net_topo.ServerSideOFSWs.size(), 0);
+        for (int c = 0; c < requests_qty; c++)
+        {
+            int last_sssw = last_sssw_of_cssw[net_topo.client_cssw[c]];
+            for (int l = 0; l < m_c; l++)
+            {
+                for (int s = 0; s < srv_qty; s++)
+                {
+                    if (w_fixed[(c * m_c + l) * srv_qty + s] == 1)
+                    {
+                        layer_server[c * m_c + l] = s;
+                        layer_cost[c * m_c + l] = 0;
+                        quality[c] = l + 1; // fixed layers and the layers below them are given
+                    }
+                }
+                if (layer_server[c * m_c + l] >= 0 || last_sssw < 0)
+                    continue;
+                auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[last_sssw + srv_qty];
+                for (int i = 0; i < connected_servers.size(); i++) // servers of last sssw take layers in turn
+                {
+                    int s = connected_servers.begin()[(next_server[last_sssw] + i) % connected_servers.size()];
+                    if (w_fixed[(c * m_c + l) * srv_qty + s] != 0)
+                    {
+                        layer_server[c * m_c + l] = s;
+                        layer_cost[c * m_c + l] = b_bar_cl[c][l];
+                        next_server[last_sssw] = (next_server[last_sssw] + i + 1) % connected_servers.size();
+                        break;
+                    }
+                }
+            }
+            while (max_q[c] < m_c && layer_cost[c * m_c + max_q[c]] >= 0)
+                max_q[c]++;
+            quality[c] = std::max(quality[c], 1);
+        }
+        min_q = quality;
+
+        capacity.assign(cssw_qty, 0);
+        for (int y = 0; y < cssw_qty; y++)
+            capacity[y] = last_sssw_of_cssw[y] >= 0 ? (double)r_sc_sol[last_sssw_of_cssw[y]][y] : 0.0;
+        feasible = true;
+        std::vector<double> load(cssw_qty, 0);
+        for (int c = 0; c < requests_qty; c++)
+        {
+            if (min_q[c] > max_q[c])
+                feasible = false; // a layer below a fixed one or the base layer has no server
+            else
+                load[net_topo.client_cssw[c]] += rate_between(c, 0, min_q[c]);
+        }
+        for (int y = 0; y < cssw_qty; y++)
+            feasible = feasible && load[y] <= capacity[y] + 1e-9;
+        return feasible;
+    }
+
+    virtual bool solve(const Demand_Model &b_bar_cl, IloNumArray2 &r_sc_sol, const std::vector<int> &w_fixed, const std::vector<int> &last_sssw_of_cssw, int segment_index)
+    {
+        auto solve_start_time = std::chrono::steady_clock::now();
+        if (prepare(b_bar_cl, r_sc_sol, w_fixed, last_sssw_of_cssw, segment_index))
+            improve();
+        finish(solve_start_time);
+        return feasible;
+    }
+
+    // steps 2-4 on the current quality, within the rate left on each cssw
+    void improve()
+    {
+        int requests_qty = net_topo.requests_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        std::vector<double> load(cssw_qty, 0);
+        for (int c = 0; c < requests_qty; c++)
+            load[net_topo.client_cssw[c]] += rate_between(c, 0, quality[c]);
+
+        // floor raising
+        int floor_q = m_c;
+        for (int c = 0; c < requests_qty; c++)
+            floor_q = std::min(floor_q, quality[c]);
+        while (floor_q < m_c)
+        {
+            std::vector<double> extra(cssw_qty, 0);
+            double delta = -30.0 / m_c * requests_qty; // objective change times requests_qty
+            bool possible = true;
+            for (int c = 0; c < requests_qty && possible; c++)
+            {
+                if (quality[c] > floor_q)
+                    continue;
+                possible = max_q[c] > floor_q;
+                if (possible)
+                {
+                    extra[net_topo.client_cssw[c]] += layer_cost[c * m_c + floor_q];
+                    delta += switch_cost(c, floor_q + 1) - switch_cost(c, floor_q);
+                }
+            }
+            for (int y = 0; y < cssw_qty && possible; y++)
+                possible = load[y] + extra[y] <= capacity[y] + 1e-9;
+            if (!possible || delta >= 0)
+                break;
+            for (int c = 0; c < requests_qty; c++)
+            {
+                if (quality[c] == floor_q)
+                    quality[c]++;
+            }
+            for (int y = 0; y < cssw_qty; y++)
+                load[y] += extra[y];
+            floor_q++;
+        }
+
+        // moves toward l_bar_c, best gain per rate first
+        if (!first_segment)
+        {
+            std::vector<std::tuple<double, int, int>> moves; // (gain / rate, client, target quality)
+            for (int c = 0; c < requests_qty; c++)
+            {
+                for (int q = quality[c] + 1; q <= std::min(l_bar_c[c], max_q[c]); q++)
+                {
+                    double gain = switch_cost(c, quality[c]) - switch_cost(c, q);
+                    moves.emplace_back(gain / std::max(rate_between(c, quality[c], q), 1e-9), c, q);
+                }
+            }
+            std::sort(moves.begin(), moves.end(), [](const std::tuple<double, int, int> &a, const std::tuple<double, int, int> &b)
+                      { return std::get<0>(a) > std::get<0>(b); });
+            for (auto &move : moves)
+            {
+                int c = std::get<1>(move);
+                int q = std::get<2>(move);
+                int y = net_topo.client_cssw[c];
+                if (q <= quality[c] || switch_cost(c, q) >= switch_cost(c, quality[c]))
+                    continue;
+                double rate = rate_between(c, quality[c], q);
+                if (load[y] + rate > capacity[y] + 1e-9)
+                    continue;
+                load[y] += rate;
+                quality[c] = q;
+            }
+        }
+
+        // free capacity in the first segment
+        if (first_segment)
+        {
+            std::vector<std::pair<double, int>> next_layers; // (rate, client)
+            for (int l = 1; l < m_c; l++)
+            {
+                next_layers.clear();
+                for (int c = 0; c < requests_qty; c++)
+                {
+                    if (quality[c] == l && max_q[c] > l)
+                        next_layers.emplace_back(layer_cost[c * m_c + l], c);
+                }
+                std::sort(next_layers.begin(), next_layers.end());
+                for (auto &next_layer : next_layers)
+                {
+                    int y = net_topo.client_cssw[next_layer.second];
+                    if (load[y] + next_layer.first <= capacity[y] + 1e-9)
+                    {
+                        load[y] += next_layer.first;
+                        quality[next_layer.second]++;
+                    }
+                }
+            }
+        }
+    }
+
+    // drops servers of layers above quality, sets objective, lower_bound and solve_time
+    void finish(std::chrono::steady_clock::time_point solve_start_time)
+    {
+        for (int c = 0; c < net_topo.requests_qty; c++)
+        {
+            for (int l = quality[c]; l < m_c; l++)
+                layer_server[c * m_c + l] = -1;
+        }
+        objective = objective_of(quality);
+        lower_bound = std::max(lower_bound, relaxation_bound());
+        solve_time = std::chrono::steady_clock::now() - solve_start_time;
+    }
+
+    // Lower bound of master from its continuous relaxation. With fractional w_s_cl, the cheapest rate of quality t is the lower convex
+    // hull of the layer prefix rates (constraint 3 only keeps w of a layer under the one below it). The largest fractional floor of each cssw is found by bisection.
+    double relaxation_bound() const
+    {
+        int requests_qty = net_topo.requests_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        double t_max = m_c;
+        for (int c = 0; c < requests_qty; c++)
+            t_max = std::min(t_max, (double)max_q[c]);
+        std::vector<double> hull_rate(requests_qty * (m_c + 1), 0); // [c * (m_c + 1) + q]
+        std::vector<double> prefix_rate(m_c + 1, 0);
+        for (int c = 0; c < requests_qty; c++)
+        {
+            for (int q = 1; q <= max_q[c]; q++)
+                prefix_rate[q] = prefix_rate[q - 1] + layer_cost[c * m_c + q - 1];
+            for (int q = 1; q <= max_q[c]; q++)
+            {
+                double rate = prefix_rate[q];
+                for (int i = 1; i < q; i++)
+                    for (int j = q + 1; j <= max_q[c]; j++)
+                        rate = std::min(rate, prefix_rate[i] + (prefix_rate[j] - prefix_rate[i]) * (q - i) / (j - i));
+                hull_rate[c * (m_c + 1) + q] = rate;
+            }
+        }
+        for (int y = 0; y < cssw_qty; y++)
+        {
+            auto floor_rate = [&](double t)
+            {
+                double rate = 0;
+                int q = std::max(1, (int)std::floor(t));
+                for (int c : net_topo.client_attachments[y].clients)
+                {
+                    const double *hull = &hull_rate[c * (m_c + 1)];
+                    rate += q < max_q[c] ? hull[q] + (hull[q + 1] - hull[q]) * (t - q) : hull[max_q[c]];
+                }
+                return rate;
+            };
+            if (floor_rate(t_max) <= capacity[y])
+                continue;
+            double lo = 0, hi = t_max;
+            for (int i = 0; i < 40; i++)
+            {
+                double mid = (lo + hi) / 2;
+                (floor_rate(mid) <= capacity[y] ? lo : hi) = mid;
+            }
+            t_max = lo;
+        }
+        auto relaxed_objective = [&](double t)
+        {
+            double value = 30.0 * std::max(0.0, 1.0 - t / m_c);
+            if (first_segment)
+                return value;
+            for (int c = 0; c < requests_qty; c++)
+            {
+                double a = std::max(0.0, t - l_bar_c[c]);
+                value += (3.0 * (mu_bar_c[c] + a) / I_max + 7.0 * (v_bar_c[c] + a / m_c) / N_max) / requests_qty;
+            }
+            return value;
+        };
+        double bound = relaxed_objective(t_max); // piecewise linear in t, breakpoints are at integers
+        for (int t = 1; t < t_max; t++)
+            bound = std::min(bound, relaxed_objective(t));
+        return bound;
+    }
+
+    void report(const char *mode) const
+    {
+        cout << mode << (feasible ? "" : " (infeasible)") << ": objective " << objective << ", relaxation bound " << lower_bound << ", gap "
+             << (objective > 0 ? 100.0 * (objective - lower_bound) / objective : 0.0) << "% in " << solve_time.count() << " ms\n";
+    }
+};
+
+// Lagrangian decomposition of master (--master=lagrangian). The rate rows of the cssws are the only rows shared by clients, the
+// normalizers (T_max, I_max, N_max) are constants of the cycle and Q is handled by solving for each quality floor t (q_c >= t,
+// Q = 1 - t / m_c). Rate rows are moved into the objective with one multiplier per cssw, so each client picks its own quality
+// (m_c layers x the servers left to it by the pre-assignment) on the thread pool. Multipliers follow a Polyak subgradient step,
+// each iterate is repaired per cssw (in parallel) into a feasible assignment and the best one is kept. The best dual value of the
+// floors is the lower bound. Multipliers are kept for the next cycle.
+class Lagrangian_Master : public Greedy_Master
+{
+public:
+    Lagrangian_Master(Net_Topo &net_topo, int m_c, Thread_Pool &pool) : Greedy_Master(net_topo, m_c), pool(pool) {}
+
+    Thread_Pool &pool;
+    int max_iterations = 50; // per floor
+    double gap_tolerance = 0.01;
+    std::vector<double> multipliers; // [t * cssw_qty + y]
+    int iterations = 0;
+
+    bool solve(const Demand_Model &b_bar_cl, IloNumArray2 &r_sc_sol, const std::vector<int> &w_fixed, const std::vector<int> &last_sssw_of_cssw, int segment_index) override
+    {
+        auto solve_start_time = std::chrono::steady_clock::now();
+        if (!Greedy_Master::solve(b_bar_cl, r_sc_sol, w_fixed, last_sssw_of_cssw, segment_index))
+            return false; // base and fixed layers don't fit, every floor is infeasible
+        int requests_qty = net_topo.requests_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int worker_qty = pool.size();
+        multipliers.resize((m_c + 1) * cssw_qty, 0);
+        iterations = 0;
+
+        std::vector<int> best_quality = quality; // greedy's solution is the first incumbent
+        double best_objective = objective;
+        double dual_bound = IloInfinity;
+        std::vector<int> q_relaxed(requests_qty);
+        std::vector<int> q_repaired(requests_qty);
+        std::vector<std::vector<double>> worker_load(worker_qty, std::vector<double>(cssw_qty));
+        std::vector<double> worker_value(worker_qty);
+        std::vector<double> subgradient(cssw_qty);
+
+        for (int t = 1; t <= m_c; t++)
+        {
+            // floor t is infeasible if a client can't reach it or a cssw can't carry it
+            bool floor_feasible = true;
+            std::vector<double> floor_load(cssw_qty, 0);
+            for (int c = 0; c < requests_qty && floor_feasible; c++)
+            {
+                floor_feasible = max_q[c] >= t;
+                floor_load[net_topo.client_cssw[c]] += rate_between(c, 0, std::max(t, min_q[c]));
+            }
+            for (int y = 0; y < cssw_qty && floor_feasible; y++)
+                floor_feasible = floor_load[y] <= capacity[y] + 1e-9;
+            if (!floor_feasible)
+                continue;
+
+            double *lambda = &multipliers[t * cssw_qty];
+            double floor_cost = 30.0 * (1.0 - t / (double)m_c);
+            double floor_dual = -IloInfinity;
+            double floor_best = IloInfinity;
+            double step_scale = 2.0;
+            int no_improvement = 0;
+            for (int it = 0; it < max_iterations; it++, iterations++)
+            {
+                if (std::chrono::duration<double>(std::chrono::steady_clock::now() - solve_start_time).count() > time_budget)
+                    break;
+                // clients' subproblems
+                pool.parallel_for(requests_qty, [&](int w, int begin, int end)
+                                  {
+                                      std::fill(worker_load[w].begin(), worker_load[w].end(), 0.0);
+                                      worker_value[w] = 0;
+                                      for (int c = begin; c < end; c++)
+                                      {
+                                          int y = net_topo.client_cssw[c];
+                                          int q_low = std::max(t, min_q[c]);
+                                          double rate = rate_between(c, 0, q_low);
+                                          double best_value = switch_cost(c, q_low) / requests_qty + lambda[y] * rate;
+                                          double best_rate = rate;
+                                          q_relaxed[c] = q_low;
+                                          for (int q = q_low + 1; q <= max_q[c]; q++)
+                                          {
+                                              rate += layer_cost[c * m_c + q - 1];
+                                              double value = switch_cost(c, q) / requests_qty + lambda[y] * rate;
+                                              if (value < best_value - 1e-12)
+                                              {
+                                                  best_value = value;
+                                                  best_rate = rate;
+                                                  q_relaxed[c] = q;
+                                              }
+                                          }
+                                          worker_load[w][y] += best_rate;
+                                          worker_value[w] += best_value;
+                                      } });
+                double dual = floor_cost;
+                std::fill(subgradient.begin(), subgradient.end(), 0.0);
+                for (int w = 0; w < worker_qty; w++)
+                {
+                    dual += worker_value[w];
+                    for (int y = 0; y < cssw_qty; y++)
+                        subgradient[y] += worker_load[w][y];
+                }
+                double norm = 0;
+                for (int y = 0; y < cssw_qty; y++)
+                {
+                    dual -= lambda[y] * capacity[y];
+                    subgradient[y] -= capacity[y];
+                    if (lambda[y] <= 0 && subgradient[y] < 0)
+                        subgradient[y] = 0; // projected on lambda >= 0
+                    norm += subgradient[y] * subgradient[y];
+                }
+                if (dual > floor_dual + 1e-9)
+                {
+                    floor_dual = dual;
+                    no_improvement = 0;
+                }
+                else if (++no_improvement >= 5)
+                {
+                    step_scale /= 2;
+                    no_improvement = 0;
+                }
+
+                q_repaired = q_relaxed;
+                repair(q_repaired, t);
+                double repaired_objective = objective_of(q_repaired);
+                floor_best = std::min(floor_best, repaired_objective);
+                if (repaired_objective < best_objective - 1e-12)
+                {
+                    best_objective = repaired_objective;
+                    best_quality = q_repaired;
+                }
+                if (norm == 0 || floor_best - floor_dual <= gap_tolerance * std::abs(floor_best))
+                    break;
+                double step = step_scale * (floor_best - floor_dual) / norm;
+                for (int y = 0; y < cssw_qty; y++)
+                    lambda[y] = std::max(0.0, lambda[y] + step * subgradient[y]);
+            }
+            dual_bound = std::min(dual_bound, floor_dual);
+        }
+
+        quality = best_quality;
+        lower_bound = dual_bound;
+        finish(solve_start_time);
+        return feasible;
+    }
+
+    // makes q feasible for floor t, cssw by cssw in parallel: layers with the smallest objective loss per rate are dropped until the
+    // rate row holds, then clients below l_bar_c move toward it by best gain per rate while rate is left
+    void repair(std::vector<int> &q, int t)
+    {
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        pool.parallel_for(cssw_qty, [&](int, int begin, int end)
+                          {
+                              std::vector<std::tuple<double, int, int>> moves; // (gain or loss / rate, client, quality)
+                              for (int y = begin; y < end; y++)
+                              {
+                                  const std::vector<int> &clients = net_topo.client_attachments[y].clients;
+                                  double load = 0;
+                                  for (int c : clients)
+                                      load += rate_between(c, 0, q[c]);
+                                  // (loss / rate of the top layer, client), smallest loss first
+                                  std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<std::pair<double, int>>> drops;
+                                  auto push_drop = [&](int c)
+                                  {
+                                      if (q[c] > std::max(t, min_q[c]) && layer_cost[c * m_c + q[c] - 1] > 0)
+                                          drops.emplace((switch_cost(c, q[c] - 1) - switch_cost(c, q[c])) / layer_cost[c * m_c + q[c] - 1], c);
+                                  };
+                                  if (load > capacity[y] + 1e-9)
+                                  {
+                                      for (int c : clients)
+                                          push_drop(c);
+                                  }
+                                  while (load > capacity[y] + 1e-9 && !drops.empty()) // a feasible floor always fits
+                                  {
+                                      int c = drops.top().second;
+                                      drops.pop();
+                                      load -= layer_cost[c * m_c + q[c] - 1];
+                                      q[c]--;
+                                      push_drop(c);
+                                  }
+
+                                  moves.clear();
+                                  for (int c : clients)
+                                  {
+                                      for (int q_to = q[c] + 1; q_to <= std::min(l_bar_c[c], max_q[c]); q_to++)
+                                      {
+                                          double gain = switch_cost(c, q[c]) - switch_cost(c, q_to);
+                                          if (gain > 0)
+                                              moves.emplace_back(gain / std::max(rate_between(c, q[c], q_to), 1e-9), c, q_to);
+                                      }
+                                  }
+                                  std::sort(moves.begin(), moves.end(), [](const std::tuple<double, int, int> &a, const std::tuple<double, int, int> &b)
+                                            { return std::get<0>(a) > std::get<0>(b); });
+                                  for (auto &move : moves)
+                                  {
+                                      int c = std::get<1>(move);
+                                      int q_to = std::get<2>(move);
+                                      if (q_to <= q[c] || switch_cost(c, q_to) >= switch_cost(c, q[c]))
+                                          continue;
+                                      double rate = rate_between(c, q[c], q_to);
+                                      if (load + rate > capacity[y] + 1e-9)
+                                          continue;
+                                      load += rate;
+                                      q[c] = q_to;
+                                  }
+                              } });
+    }
+};
+
+// Partitioned master (--master=partitioned). Clients of each cssw are dealt round robin to group_qty groups. Each group gets its
+// base and fixed layers' rate of every cssw's r_sc plus a share of the rest proportional to the rate its other layers could use,
+// and solves master's MILP over its own clients (quality of each client as one binary per q, servers are given by prepare()) in
+// its own env with one CPLEX thread. Groups run on the thread pool with work stealing. A group without solution keeps its base
+// and fixed layers. Rate left by the groups is then spent by Greedy_Master's floor raising and moves toward l_bar_c.
+class Partitioned_Master : public Greedy_Master
+{
+public:
+    Partitioned_Master(Net_Topo &net_topo, int m_c, Thread_Pool &pool, int group_qty) : Greedy_Master(net_topo, m_c), pool(pool), group_qty(group_qty) {}
+
+    Thread_Pool &pool;
+    int group_qty;
+    int solved_groups = 0;
+
+    bool solve(const Demand_Model &b_bar_cl, IloNumArray2 &r_sc_sol, const std::vector<int> &w_fixed, const std::vector<int> &last_sssw_of_cssw, int segment_index) override
+    {
+        auto solve_start_time = std::chrono::steady_clock::now();
+        if (!prepare(b_bar_cl, r_sc_sol, w_fixed, last_sssw_of_cssw, segment_index))
+        {
+            finish(solve_start_time);
+            return false;
+        }
+        int requests_qty = net_topo.requests_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int groups = std::max(1, std::min(group_qty, requests_qty));
+
+        std::vector<std::vector<int>> group_clients(groups);
+        std::vector<std::vector<double>> share(groups, std::vector<double>(cssw_qty, 0)); // rate of each cssw given to the group
+        std::vector<std::vector<double>> extra_demand(groups, std::vector<double>(cssw_qty, 0));
+        std::vector<double> spare = capacity;
+        std::vector<double> total_extra_demand(cssw_qty, 0);
+        for (int y = 0; y < cssw_qty; y++)
+        {
+            int member = 0;
+            for (int c : net_topo.client_attachments[y].clients)
+            {
+                int g = member++ % groups;
+                group_clients[g].push_back(c);
+                double base_rate = rate_between(c, 0, min_q[c]);
+                double extra_rate = rate_between(c, min_q[c], max_q[c]);
+                share[g][y] += base_rate;
+                spare[y] -= base_rate;
+                extra_demand[g][y] += extra_rate;
+                total_extra_demand[y] += extra_rate;
+            }
+        }
+        for (int g = 0; g < groups; g++)
+        {
+            for (int y = 0; y < cssw_qty; y++)
+            {
+                if (total_extra_demand[y] > 0)
+                    share[g][y] += std::max(0.0, spare[y]) * extra_demand[g][y] / total_extra_demand[y];
+            }
+        }
+
+        std::atomic<int> solved(0);
+        auto deadline = solve_start_time + std::chrono::microseconds((long long)(time_budget * 1e6));
+        pool.run_tasks(groups, [&](int, int g)
+                       {
+                           if (solve_group(group_clients[g], share[g], deadline))
+                               solved++;
+                       });
+        solved_groups = solved;
+
+        improve(); // rebalancing of the rate left by the groups
+        finish(solve_start_time);
+        return feasible;
+    }
+
+    // writes quality of clients, they're left at min_q if the group has no solution or starts after the deadline.
+    // Groups queued behind others on the pool get the time left when they start, not the whole budget.
+    bool solve_group(const std::vector<int> &clients, const std::vector<double> &group_share, std::chrono::steady_clock::time_point deadline)
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        IloEnv env;
+        bool solved = false;
+        try
+        {
+            int requests_qty = net_topo.requests_qty;
+            int cssw_qty = net_topo.ClientSideOFSWs.size();
+            IloModel model(env, "masterGroupMod");
+            IloNumVar Q(env, 0, 1);
+            std::vector<IloBoolVarArray> y_cq; // y_cq[i][q - min_q]: whether client i of the group gets quality q
+            std::vector<IloExpr> rate_exprs;
+            for (int y = 0; y < cssw_qty; y++)
+                rate_exprs.emplace_back(env);
+            IloExpr switch_expr(env);
+            for (int c : clients)
+            {
+                int cssw = net_topo.client_cssw[c];
+                y_cq.emplace_back(env, max_q[c] - min_q[c] + 1);
+                IloBoolVarArray &y_c = y_cq.back();
+                IloExpr choice_expr(env);
+                IloExpr quality_expr(env);
+                for (int q = min_q[c]; q <= max_q[c]; q++)
+                {
+                    choice_expr += y_c[q - min_q[c]];
+                    quality_expr += q * y_c[q - min_q[c]];
+                    rate_exprs[cssw] += rate_between(c, 0, q) * y_c[q - min_q[c]];
+                    switch_expr += switch_cost(c, q) / requests_qty * y_c[q - min_q[c]];
+                }
+                model.add(choice_expr == 1);              // CONST 0, 1 and 3 - one quality, layers in order
+                model.add(Q + quality_expr / m_c >= 1.0); // CONST 4
+                choice_expr.end();
+                quality_expr.end();
+            }
+            for (int y = 0; y < cssw_qty; y++)
+            {
+                model.add(rate_exprs[y] <= group_share[y]);
+                rate_exprs[y].end();
+            }
+            model.add(IloMinimize(env, 30 * Q + switch_expr));
+            switch_expr.end();
+
+            IloCplex cplex(model);
+            cplex.setOut(env.getNullStream());
+            cplex.setWarning(env.getNullStream());
+            cplex.setParam(IloCplex::Param::Threads, 1); // parallelism comes from the groups
+            double time_left = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+            cplex.setParam(IloCplex::Param::TimeLimit, std::max(time_left, 1e-3));
+            cplex.setParam(IloCplex::Param::MIP::Tolerances::MIPGap, 0.01);
+            if (cplex.solve())
+            {
+                solved = true;
+                for (size_t i = 0; i < clients.size(); i++)
+                {
+                    int c = clients[i];
+                    for (int q = min_q[c]; q <= max_q[c]; q++)
+                    {
+                        if (cplex.getValue(y_cq[i][q - min_q[c]]) > 0.5)
+                            quality[c] = q;
+                    }
+                }
+            }
+        }
+        catch (const IloException &e)
+        {
+            cerr << "Exception caught: " << e << endl;
+        }
+        env.end();
+        return solved;
     }
+};
 
-    /*
-    // master problem server load balancing contraint
-    for (int k = 0; k < net_topo.srv_qty; k++)
-    { // each server - e array's first srv_qty element contraints servers. so loop starts from 0
-        IloExpr master_srv_lb_expr(masterEnv);
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            layer_qty = m_c;
-            // layer_qty = b_bar_cl[i].size();
-            for (int j = 0; j < layer_qty; j++)
-            { // each layer of request
-                // master_srv_lb_expr_arr[k] += w_s_cl[i][j][k];
-                master_srv_lb_expr += w_s_cl[i][j][k];
-            }
+// --mip-start values. "off" isn't listed, no MIP start is given then.
+const std::map<std::string, IloCplex::MIPStartEffort> &mip_start_efforts()
+{
+    static const std::map<std::string, IloCplex::MIPStartEffort> efforts = {
+        {"auto", IloCplex::MIPStartAuto}, {"checkfeas", IloCplex::MIPStartCheckFeas}, {"solvefixed", IloCplex::MIPStartSolveFixed},
+        {"solvemip", IloCplex::MIPStartSolveMIP}, {"repair", IloCplex::MIPStartRepair}, {"nocheck", IloCplex::MIPStartNoCheck}};
+    return efforts;
+}
+
+// First incumbent of a master solve, filled by Incumbent_Watch_I
+// CPLEX runs a copy of the callback on each of its threads, they all write here under mutex. master() reads it after solve().
+struct Incumbent_Watch
+{
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point solve_start;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    bool found = false;
+    bool deadline_reached = false;
+    int incumbents = 0;
+    double best_objective = IloInfinity;
+    bool from_mip_start = false;
+    double first_incumbent_ms = 0;
+
+    void reset(std::chrono::steady_clock::time_point start)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        solve_start = start;
+        deadline = std::chrono::steady_clock::time_point::max();
+        found = false;
+        deadline_reached = false;
+        incumbents = 0;
+        best_objective = IloInfinity;
+        from_mip_start = false;
+        first_incumbent_ms = 0;
+    }
+};
+
+class Incumbent_Watch_I : public IloCplex::IncumbentCallbackI
+{
+public:
+    Incumbent_Watch_I(IloEnv env, Incumbent_Watch *watch) : IloCplex::IncumbentCallbackI(env), watch(watch) {}
+    Incumbent_Watch *watch;
+
+    // CPLEX keeps the incumbent, it's read by master() with getValues. Search is stopped here if the deadline passed,
+    // TimeLimit alone overshoots it when an incumbent comes at the end of a long node.
+    void main()
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(watch->mutex);
+        watch->incumbents++;
+        watch->best_objective = std::min(watch->best_objective, (double)getObjValue());
+        if (!watch->found)
+        {
+            watch->found = true;
+            watch->from_mip_start = getSolutionSource() == MIPStartSolution;
+            watch->first_incumbent_ms = std::chrono::duration<double, std::milli>(now - watch->solve_start).count();
         }
-        master_srv_lb_expr_arr[k] = master_srv_lb_expr;
-    } // End of master problem server load balancing contraint
-    */
+        if (now >= watch->deadline)
+        {
+            watch->deadline_reached = true;
+            abort();
+        }
+    }
+    IloCplex::CallbackI *duplicateCallback() const
+    {
+        return new (getEnv()) Incumbent_Watch_I(*this);
+    }
+};
+
+// Master MILP (OPM) kept alive between optimization cycles. Constraints 0-8 are built once. Values that come from client history
+// (lambda_bar_c, l_bar_c, mu_bar_c, v_bar_c), phi_c, T_max/I_max/N_max, layer sizes and r_sc_sol are written into the live model
+// by update() as coefficient, RHS and bound changes.
+// To keep these constants out of nonlinear terms, q_c (quality of c, sum of its w_s_cl), d_c = q_c - l_bar_c and a_c = |d_c| are
+// modelled as variables. Constraints 6 and 7 are relaxed (LB = -inf) for the first segment instead of being left out.
+class Master_MILP : public Master_Results
+{
+public:
+    Master_MILP(Net_Topo &net_topo, int m_c, int a_s_cl = 1)
+        : Master_Results(net_topo.requests_qty, m_c, net_topo.srv_qty), net_topo(net_topo), requests_qty(net_topo.requests_qty), m_c(m_c), a_s_cl(a_s_cl), model(env, "masterMod"),
+          masterCplex(env), greedy(net_topo, m_c)
+    {
+        auto build_start_time = std::chrono::steady_clock::now();
+        build();
+        build_time = std::chrono::steady_clock::now() - build_start_time;
+        cout << "master MILP built in " << build_time.count() << " ms\n";
+    }
 
-    // master problem constraint (1)
-    for (int i = 0; i < requests_qty; i++)
-    { // each client (request)
-        // layer_qty = b_bar_cl[i].size();
-        layer_qty = m_c;
-        masterConst1_RangeArr[i] = IloRangeArray(masterEnv, layer_qty);
-        for (int j = 0; j < layer_qty; j++)
-        { // each layer of request
-            IloExpr master_const1_expr(masterEnv);
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            { // each server - e array's first srv_qty element contraints servers. so loop starts from 0
-                master_const1_expr += w_s_cl[i][j][k];
+    Net_Topo &net_topo;
+    int requests_qty;
+    int m_c;
+    int a_s_cl; // whether servers hold the video, the same for every server and layer. It's the UB of w_s_cl instead of CONST 2
+    IloModel model;
+    IloCplex masterCplex;
+    std::chrono::duration<double, std::milli> build_time;
+
+    IloIntVarArray3 w_s_cl; // whether server s serves layer l to client c
+    IloNumVar Q;
+    IloNumVar L;
+    IloNumVarArray T_c;
+    IloNumVarArray I_c;
+    IloIntVarArray v_c;
+    IloNumVarArray N_c;
+    IloNumVarArray q_c; // quality (layer qty) of c
+    IloNumVarArray d_c; // quality change of c, q_c - l_bar_c
+    IloNumVarArray a_c; // |d_c|
+    IloNumVarArray switch_up_c;   // --switch-model=linear, d_c = up - down, a_c = up + down
+    IloNumVarArray switch_down_c;
+    std::vector<IloConversion> w_relaxations; // --quality-model=integer, w_s_cl of c as continuous, in the model while it's exact
+    std::vector<bool> w_relaxed;
+
+    IloRangeArray masterConst5_RangeArr;
+    IloRangeArray masterConst6_RangeArr;
+    IloRangeArray masterConst7_RangeArr1;
+    IloRangeArray masterConst7_RangeArr2;
+    IloRangeArray masterConst8_RangeArr;
+    IloRangeArray quality_change_RangeArr;                     // d_c - q_c == -l_bar_c
+    std::vector<std::vector<IloRange>> sssw_cssw_rate_ranges; // layers served by sssw's servers to clients of cssw <= r_sc_sol, active for the last sssw of cssw
+    std::vector<std::vector<bool>> rate_range_in_model;        // presolve() keeps only binding rate rows in the model
+
+    Incumbent_Watch incumbent_watch;
+    Greedy_Master greedy; // its solution is the second MIP start
+    bool has_previous_solution = false; // w_s_cl_sol and v_c_sol hold previous segment's assignment
+    bool mip_start_added = false;
+    double cold_first_incumbent_ms = -1; // time to first incumbent of the last solve without MIP start
+    int solve_count = 0;
+
+    void build()
+    {
+        int srv_qty = net_topo.srv_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
+
+        w_s_cl = IloIntVarArray3(env, requests_qty);
+        Q = IloNumVar(env, 0, 1);
+        L = IloNumVar(env, 0, 1);
+        T_c = IloNumVarArray(env, requests_qty, 0, 1);
+        I_c = IloNumVarArray(env, requests_qty, 0, 1);
+        v_c = IloIntVarArray(env, requests_qty, 0, 1);
+        N_c = IloNumVarArray(env, requests_qty, 0, 1);
+        q_c = IloNumVarArray(env, requests_qty, 0, m_c);
+        d_c = IloNumVarArray(env, requests_qty, -m_c, m_c);
+        a_c = IloNumVarArray(env, requests_qty, 0, m_c);
+        switch_up_c = IloNumVarArray(env, requests_qty, 0, m_c);
+        switch_down_c = IloNumVarArray(env, requests_qty, 0, m_c);
+        masterConst5_RangeArr = IloRangeArray(env, requests_qty);
+        masterConst6_RangeArr = IloRangeArray(env, requests_qty);
+        masterConst7_RangeArr1 = IloRangeArray(env, requests_qty);
+        masterConst7_RangeArr2 = IloRangeArray(env, requests_qty);
+        masterConst8_RangeArr = IloRangeArray(env, requests_qty);
+        quality_change_RangeArr = IloRangeArray(env, requests_qty);
+
+        // w_s_cl vars init
+        for (int i = 0; i < requests_qty; i++)
+        {
+            w_s_cl[i] = IloArray<IloIntVarArray>(env, m_c); // defining layer array of each c
+            for (int j = 0; j < m_c; j++)
+            {
+                w_s_cl[i][j] = IloIntVarArray(env, srv_qty, 0, a_s_cl); // defining cplex variable array for w
+                for (int k = 0; k < srv_qty; k++)
+                {
+                    char varName[100]; // used to assign variable names in IntVarArrays
+                    sprintf(varName, "w_s:%d_c:%d_l:%d", k, i, j);
+                    w_s_cl[i][j][k].setName(varName);
+                }
             }
-            masterConst1_RangeArr[i][j] = (master_const1_expr <= 1); // CONST 1
-            master_const1_expr.end();
         }
-    } // end of master problem constrain (1)
 
-    // master problem constraint (2)
-    for (int i = 0; i < requests_qty; i++)
-    { // each client (request)
-        // layer_qty = b_bar_cl[i].size();
-        layer_qty = m_c;
-        // cout << "m_c 14:" << m_c << "\n";
-
-        masterConst2_RangeArr[i] = IloArray<IloRangeArray>(masterEnv, layer_qty);
-        for (int j = 0; j < layer_qty; j++)
-        { // each layer of request
-            masterConst2_RangeArr[i][j] = IloRangeArray(masterEnv, net_topo.srv_qty);
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            {                                                                 // each server - e array's first srv_qty element contains servers. so loop starts from 0
-                masterConst2_RangeArr[i][j][k] = (w_s_cl[i][j][k] <= a_s_cl); // not actually used. We assumed that each server holds each video file.
+        // Rows that can't cut anything are not built: CONST 2 is the UB of w_s_cl, CONST 1 is implied by the binary bounds when there is
+        // one server and by CONST 0 for the base layer.
+        int skipped_rows = requests_qty * m_c * srv_qty;
+        IloExpr I_cs(env);
+        IloExpr N_cs(env);
+        for (int i = 0; i < requests_qty; i++)
+        {
+            IloExpr quality_expr(env);
+            for (int j = 0; j < m_c; j++)
+            {
+                IloExpr layer_expr(env);
+                for (int k = 0; k < srv_qty; k++)
+                {
+                    layer_expr += w_s_cl[i][j][k];
+                    quality_expr += w_s_cl[i][j][k];
+                    // model.add(w_s_cl[i][j][k] <= a_s_cl); // CONST 2 - not actually used. We assumed that each server holds each video file.
+                }
+                if (j == 0)
+                    model.add(layer_expr == 1); // CONST 0 - base layer
+                else if (srv_qty > 1)
+                    model.add(layer_expr <= 1); // CONST 1
+                else
+                    skipped_rows++;
+                if (j == 0)
+                    skipped_rows++;
+                layer_expr.end();
+            }
+            for (int j = 0; j < m_c - 1; j++)
+            {
+                IloExpr master_const3_expr(env);
+                for (int k = 0; k < srv_qty; k++)
+                {
+                    master_const3_expr += w_s_cl[i][j + 1][k] - w_s_cl[i][j][k];
+                }
+                model.add(master_const3_expr <= 0); // CONST 3
+                master_const3_expr.end();
+            }
+            model.add(q_c[i] - quality_expr == 0);
+            quality_expr.end();
+
+            model.add(Q + q_c[i] / (double)m_c >= 1.0); // CONST 4
+            // coefficients and RHS of the following rows are set by update()
+            masterConst5_RangeArr[i] = (T_c[i] - q_c[i] == 0);         // CONST 5 - T_c - q_c / (phi_c * T_max) == lambda_bar_c / (phi_c * T_max)
+            quality_change_RangeArr[i] = (d_c[i] - q_c[i] == 0);       // d_c == q_c - l_bar_c
+            if (frog_options.switch_model == "abs")
+                model.add(a_c[i] == IloAbs(d_c[i])); // a_c == |q_c - l_bar_c|, CPLEX adds its own binaries for it
+            else
+            {
+                // a_c only bounds I_c and v_c from below in rows 6 and 7, so a_c >= |d_c| is enough and up/down need no binaries
+                model.add(d_c[i] - switch_up_c[i] + switch_down_c[i] == 0);
+                model.add(a_c[i] - switch_up_c[i] - switch_down_c[i] == 0);
             }
+            masterConst6_RangeArr[i] = (I_c[i] - a_c[i] >= 0);         // CONST 6 - I_c * I_max - a_c >= mu_bar_c
+            masterConst7_RangeArr1[i] = (v_c[i] * m_c - a_c[i] >= 0);  // CONST 7 - layer switch
+            masterConst7_RangeArr2[i] = (N_c[i] - v_c[i] >= 0);        // CONST 7 - N_c * N_max - v_c >= v_bar_c
+            masterConst8_RangeArr[i] = (L + q_c[i] >= 1.0);            // CONST 8 - L + q_c / (phi_c * T_max) >= 1 - lambda_bar_c / (phi_c * T_max)
+            I_cs += I_c[i];
+            N_cs += N_c[i];
         }
-    } // end of master problem constrain (2)
-
-    // master problem constraint (3)
-    for (int i = 0; i < requests_qty; i++)
-    { // each client (request)
-        // layer_qty = b_bar_cl[i].size();
-        layer_qty = m_c;
-        // cout << "m_c 15:" << m_c << "\n";
-
-        masterConst3_RangeArr[i] = IloRangeArray(masterEnv, layer_qty - 1);
-        for (int j = 0; j < layer_qty - 1; j++)
-        { // each layer of request
-            IloExpr master_const3_expr1(masterEnv);
-            IloExpr master_const3_expr2(masterEnv);
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            { // each server - e array's first srv_qty element contains servers. so loop starts from 0
-                master_const3_expr1 += w_s_cl[i][j + 1][k];
-                master_const3_expr2 += w_s_cl[i][j][k];
+        model.add(masterConst5_RangeArr);
+        model.add(masterConst6_RangeArr);
+        model.add(masterConst7_RangeArr1);
+        model.add(masterConst7_RangeArr2);
+        model.add(masterConst8_RangeArr);
+        model.add(quality_change_RangeArr);
+
+        // one row per (sssw, cssw), only the last sssw of each cssw gets a finite RHS in master()
+        sssw_cssw_rate_ranges.assign(sssw_qty, std::vector<IloRange>(cssw_qty));
+        for (int s = 0; s < sssw_qty; s++)
+        {
+            for (int y = 0; y < cssw_qty; y++)
+            {
+                sssw_cssw_rate_ranges[s][y] = IloRange(env, -IloInfinity, IloExpr(env), IloInfinity);
             }
-            masterConst3_RangeArr[i][j] = (master_const3_expr1 - master_const3_expr2 <= 0);
-            master_const3_expr1.end();
-            master_const3_expr2.end();
         }
-    } // end of master problem constrain (3)
-
-    // master problem constraint (4)
-    for (int i = 0; i < requests_qty; i++)
-    { // each client (request)
-        layer_qty = m_c;
-        // cout << "m_c 16:" << m_c << "\n";
-
-        // layer_qty = b_bar_cl[i].size();
-        IloExpr master_const4_expr1(masterEnv);
-        for (int j = 0; j < layer_qty; j++)
-        { // each layer of request
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            { // each server - e array's first srv_qty element contains servers. so loop starts from 0
-                master_const4_expr1 += w_s_cl[i][j][k];
+        rate_range_in_model.assign(sssw_qty, std::vector<bool>(cssw_qty, false)); // added by presolve() once they get a finite RHS
+        skipped_rows += sssw_qty * cssw_qty;
+        cout << "master MILP build skipped " << skipped_rows << " redundant rows\n";
+
+        // --quality-model=integer: q_c is integer, so with one server the layers of c are only a prefix length and w_s_cl can be
+        // continuous. A fractional w with integer q_c costs at least the rate of the prefix when enhancement layer rates of c don't decrease,
+        // then rounding w to the prefix (round_to_quality()) keeps every row. update() relaxes w_s_cl of such clients only.
+        if (frog_options.quality_model == "integer")
+        {
+            model.add(IloConversion(env, q_c, ILOINT));
+            w_relaxed.assign(requests_qty, false);
+            for (int i = 0; i < requests_qty && srv_qty == 1; i++)
+            {
+                IloIntVarArray client_w(env);
+                for (int j = 0; j < m_c; j++)
+                    client_w.add(w_s_cl[i][j][0]);
+                w_relaxations.emplace_back(env, client_w, ILOFLOAT);
             }
         }
-        // cout << "************************************************m_c: " << m_c << "\n";
-        masterConst4_RangeArr1[i] = (Q + master_const4_expr1 / (double)m_c >= 1.0);
-        // masterConst4_RangeArr2[i] = (1.25 >= Q + master_const4_expr1 / (double)m_c);
-        master_const4_expr1.end();
-    } // master problem constraint (4)
 
-    /*
-    // master problem constraint (5)
-    // T_max calculation
-    int T_max = 0;
-    for (int i = 0; i < requests_qty; i++)
+        model.add(IloMinimize(env, 30 * Q + (3 * I_cs + 7 * N_cs) / (double)requests_qty)); // OBJ FUNC - 30 client 1 server genelde bununla aldık
+        I_cs.end();
+        N_cs.end();
+
+        masterCplex.extract(model);
+        masterCplex.setOut(env.getNullStream()); // Disable CPLEX logging
+        masterCplex.setWarning(env.getNullStream());
+        masterCplex.setParam(IloCplex::Param::TimeLimit, 1.0); // replaced by time_budget() at each solve
+
+        // 1. Set MIP strategy to traditional B&B (faster for small trees)
+        masterCplex.setParam(IloCplex::Param::MIP::Strategy::Search, 1); // 1 = Traditional
+        // 2. Set optimality gap tolerance to 1%
+        masterCplex.setParam(IloCplex::Param::MIP::Tolerances::MIPGap, 0.01);
+        // 3. Balanced optimality/feasibility emphasis
+        masterCplex.setParam(IloCplex::Param::Emphasis::MIP, 1); // 1 = Balanced
+        // 4. Enable aggressive presolve
+        masterCplex.setParam(IloCplex::Param::Preprocessing::Presolve, 1); // 1 = On
+        masterCplex.setParam(IloCplex::Param::Preprocessing::Aggregator, 1); // 1 = On
+        // 5. Parallel processing (4 threads)
+        masterCplex.setParam(IloCplex::Param::Threads, 4);
+        // 6. Enable strong branching
+        masterCplex.setParam(IloCplex::Param::MIP::Strategy::VariableSelect, 3); // 3 = Strong
+        // 7. Set solution pool intensity (finds good solutions faster)
+        masterCplex.setParam(IloCplex::Param::MIP::Limits::Populate, 10);
+        masterCplex.setParam(IloCplex::Param::MIP::Pool::Intensity, 2);
+        // 8. Enable RINS heuristic (finds integer solutions faster)
+        masterCplex.setParam(IloCplex::Param::MIP::Strategy::RINSHeur, 50);
+        // 9. Additional tuning for large-scale problems
+        masterCplex.setParam(IloCplex::Param::MIP::Strategy::Probe, 3);  // Aggressive probing
+        masterCplex.setParam(IloCplex::Param::MIP::Cuts::MIRCut, 2);     // Aggressive MIR cuts
+        masterCplex.setParam(IloCplex::Param::MIP::Cuts::FlowCovers, 2); // Flow cover cuts
+
+        masterCplex.use(IloCplex::Callback(new (env) Incumbent_Watch_I(env, &incumbent_watch)));
+    } // end of build()
+
+    // Greedy_Master's solution is given as MIP start, over the bounds master() fixed this cycle.
+    // Previous segment's w_s_cl_sol / v_c_sol is given as another MIP start. It's repaired first: bounds fixed by master() this cycle are kept,
+    // layers of servers turned off are moved to a free server of the cssw's last sssw, and if a cssw's layers exceed the r_sc of its
+    // last sssw, top layers of the highest quality clients are dropped until they fit.
+    // With --mip-start-reference=N, the first solve and every Nth one after it get no start, they're the reference of the "ms saved" report.
+    void add_mip_start(const Demand_Model &b_bar_cl, IloNumArray2 &r_sc_sol, std::map<int, std::vector<int>> &sorted_r_sc_sol, int segment_index)
     {
-        int lambda_bar_i = lambda_bar_c[requests[i]->get_endpoint().address().to_string()];
-        if (T_max < (lambda_bar_i + m_c))
+        mip_start_added = false;
+        if (masterCplex.getNMIPStarts() > 0)
+            masterCplex.deleteMIPStarts(0, masterCplex.getNMIPStarts());
+        auto effort_itr = mip_start_efforts().find(frog_options.mip_start);
+        if (effort_itr == mip_start_efforts().end())
+            return;
+        if (frog_options.mip_start_reference > 0 && solve_count % frog_options.mip_start_reference == 0)
         {
-            T_max = lambda_bar_i + m_c;
+            cout << "master MIP start skipped, cold reference solve\n";
+            return;
         }
-    }
-    // T_max += m_c;
-    //  cout << "T_max: " << T_max << "\n";
-    */
-    // master problem constraint (5)
-    double T_max = 0.0;
-    for (int i = 0; i < requests_qty; i++)
-    {
-        int lambda_bar_i = lambda_bar_c[i];
-        int phi_i = phi_c;
-        double T_i = (lambda_bar_i + m_c) / double(phi_i);
-        if (T_max < T_i)
+
+        int srv_qty = net_topo.srv_qty;
+        std::vector<int> w_fixed(requests_qty * m_c * srv_qty, -1);
+        std::vector<int> last_sssw_of_cssw(net_topo.ClientSideOFSWs.size(), -1);
+        for (int c = 0; c < requests_qty; c++)
+            for (int l = 0; l < m_c; l++)
+                for (int k = 0; k < srv_qty; k++)
+                    w_fixed[(c * m_c + l) * srv_qty + k] = w_s_cl[c][l][k].getLB() == 1 ? 1 : w_s_cl[c][l][k].getUB() == 0 ? 0 : -1;
+        for (auto &c_s : sorted_r_sc_sol)
+            last_sssw_of_cssw[c_s.first] = *c_s.second.rbegin();
+        if (greedy.solve(b_bar_cl, r_sc_sol, w_fixed, last_sssw_of_cssw, segment_index))
         {
-            T_max = T_i;
+            add_mip_start(greedy.layer_server, greedy.quality, segment_index, effort_itr->second);
+            mip_start_added = true;
         }
-    }
+        greedy.report("greedy MIP start");
+        if (!has_previous_solution)
+            return;
 
-    for (int i = 0; i < requests_qty; i++)
-    {
-        layer_qty = m_c;
-        IloExpr master_const5_expr(masterEnv);
-        for (int j = 0; j < layer_qty; j++)
+        std::vector<int> w_start(requests_qty * m_c, -1); // server of layer l of c, -1 if not given
+        std::vector<int> quality(requests_qty, 0);
+        for (int c = 0; c < requests_qty; c++)
         {
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            { // each server - e array's first srv_qty element contraints servers. so loop starts from 0
-                master_const5_expr += w_s_cl[i][j][k];
+            int cssw = net_topo.client_cssw[c];
+            int last_sssw = sorted_r_sc_sol.count(cssw) ? *sorted_r_sc_sol[cssw].rbegin() : -1;
+            for (int l = 0; l < m_c; l++)
+            {
+                int srv = -1;
+                int free_srv = -1;
+                for (int k = 0; k < srv_qty; k++)
+                {
+                    if (w_s_cl[c][l][k].getLB() == 1)
+                    {
+                        srv = k; // fixed by master()
+                        break;
+                    }
+                    if (w_s_cl_sol[c][l][k] > 0.5 && w_s_cl[c][l][k].getUB() == 1)
+                        srv = k;
+                }
+                if (srv < 0 && last_sssw >= 0 && (l == 0 || w_start[c * m_c + l - 1] >= 0))
+                {
+                    bool had_layer = false;
+                    for (int k = 0; k < srv_qty; k++)
+                        had_layer = had_layer || w_s_cl_sol[c][l][k] > 0.5;
+                    for (auto k : net_topo.ServerSideOFSWs_Connected_Servers[last_sssw + srv_qty])
+                    {
+                        if (w_s_cl[c][l][k].getUB() == 1)
+                        {
+                            free_srv = k;
+                            break;
+                        }
+                    }
+                    if (had_layer || l == 0) // base layer is always given
+                        srv = free_srv;
+                }
+                if (srv < 0 || (l > 0 && w_start[c * m_c + l - 1] < 0))
+                    break; // layers are given in order
+                w_start[c * m_c + l] = srv;
+                quality[c] = l + 1;
             }
         }
-        IloInt lambda_bar_i = lambda_bar_c[i];
-        IloInt phi_i = phi_c;
-        masterConst5_RangeArr[i] = (T_c[i] - (lambda_bar_i + master_const5_expr) / (phi_i * T_max) == 0); // Need to maximize T_c
-        // masterConst5_RangeArr[i] = (T_c[i] - (lambda_bar_i + master_const5_expr) / (double)T_max == 0); // Need to maximize T_c
-        master_const5_expr.end();
-    }
-    // end of master problem constraint (5)
 
-    // master problem constraint (6)
-    // I_max calculation
-    int I_max = 0;
-    for (int i = 0; i < requests_qty; i++)
-    {
-        int mu_bar_i = mu_bar_c[i];
-        if (I_max < (mu_bar_i + m_c))
+        // capacity repair on the active rows
+        for (auto &c_s : sorted_r_sc_sol)
         {
-            I_max = mu_bar_i + m_c;
+            int cssw = c_s.first;
+            int last_sssw = *c_s.second.rbegin();
+            double rate_limit = r_sc_sol[last_sssw][cssw];
+            std::vector<bool> last_sssw_server(srv_qty, false);
+            for (auto k : net_topo.ServerSideOFSWs_Connected_Servers[last_sssw + srv_qty])
+                last_sssw_server[k] = true;
+
+            double load = 0;
+            std::priority_queue<std::pair<int, int>> by_quality; // (quality, client)
+            for (int c : net_topo.client_attachments[cssw].clients)
+            {
+                for (int l = 0; l < quality[c]; l++)
+                {
+                    if (last_sssw_server[w_start[c * m_c + l]])
+                        load += b_bar_cl[c][l];
+                }
+                by_quality.emplace(quality[c], c);
+            }
+            while (load > rate_limit && !by_quality.empty())
+            {
+                int c = by_quality.top().second;
+                by_quality.pop();
+                int l = quality[c] - 1;
+                int srv = l > 0 ? w_start[c * m_c + l] : -1;
+                if (srv < 0 || !last_sssw_server[srv] || w_s_cl[c][l][srv].getLB() == 1)
+                    continue; // base layer and fixed layers stay
+                w_start[c * m_c + l] = -1;
+                quality[c]--;
+                load -= b_bar_cl[c][l];
+                by_quality.emplace(quality[c], c);
+            }
         }
+
+        add_mip_start(w_start, quality, segment_index, effort_itr->second);
+        mip_start_added = true;
     }
-    // I_max += m_c;
-    //  cout << "I_max: " << I_max << "\n";
 
-    for (int i = 0; i < requests_qty; i++)
+    // w_start[c * m_c + l]: server of layer l of c, -1 if not given
+    void add_mip_start(const std::vector<int> &w_start, const std::vector<int> &quality, int segment_index, IloCplex::MIPStartEffort effort)
     {
-        layer_qty = m_c;
-        // cout << "m_c 18:" << m_c << "\n";
-
-        // layer_qty = b_bar_cl[i].size();
-        IloExpr master_const6_expr(masterEnv);
-        for (int j = 0; j < layer_qty; j++)
+        IloNumVarArray start_vars(env);
+        IloNumArray start_vals(env);
+        for (int c = 0; c < requests_qty; c++)
         {
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            { // each server - e array's first srv_qty element contraints servers. so loop starts from 0
-                master_const6_expr += w_s_cl[i][j][k];
+            for (int l = 0; l < m_c; l++)
+            {
+                for (int k = 0; k < net_topo.srv_qty; k++)
+                {
+                    start_vars.add(w_s_cl[c][l][k]);
+                    start_vals.add(w_start[c * m_c + l] == k ? 1 : 0);
+                }
+            }
+            if (segment_index != 0)
+            {
+                start_vars.add(v_c[c]);
+                start_vals.add(quality[c] != l_bar_c[c] ? 1 : 0);
             }
         }
-        int l_bar_i = l_bar_c[i];
-        // cout << "l_bar_i: " << l_bar_i << "\n";
-        int mu_bar_i = mu_bar_c[i];
-        int phi_i = phi_c;
-        // cout << "mu_bar_i: " << mu_bar_i << "\n";
-        // cout << "master_const6_expr: " << master_const6_expr << "\n";
-
-        masterConst6_RangeArr[i] = (I_c[i] - (mu_bar_i + IloAbs(master_const6_expr - l_bar_i)) / (double)I_max >= 0);
-        masterConst7_RangeArr1[i] = (0 <= v_c[i] * m_c - IloAbs(master_const6_expr - l_bar_i));
-
-        // masterConst5_RangeArr[i] =  ( T_c[i] + (lambda_bar_i + master_const5_expr)/(double)T_max == 1 );
-        // masterConst5_RangeArr[i] =  ( (lambda_bar_i + master_const5_expr) / (T_c[i] * phi_i)  == T_max );
-        // cout << "masterConst6_RangeArr[" << i << "]: " << masterConst6_RangeArr[i] << "\n";
-        // cout << "masterConst7_RangeArr1[" << i << "]: " << masterConst7_RangeArr1[i] << "\n";
-        master_const6_expr.end();
+        masterCplex.addMIPStart(start_vars, start_vals, effort);
+        start_vars.end();
+        start_vals.end();
     }
-    // end of master problem constraint (6)
 
-    // master problem constraint (7)
-    int N_max = 0;
-    for (int i = 0; i < requests_qty; i++)
+    IloBool solve()
     {
-        int v_bar_i = v_bar_c[i];
-        if (N_max < v_bar_i)
+        incumbent_watch.reset(std::chrono::steady_clock::now());
+        double budget = time_budget();
+        if (solve_deadline != std::chrono::steady_clock::time_point())
+            incumbent_watch.deadline = std::max(solve_deadline, incumbent_watch.solve_start + std::chrono::microseconds((long long)(min_time_budget * 1e6)));
+        masterCplex.setParam(IloCplex::Param::TimeLimit, budget);
+        IloBool solved = masterCplex.solve();
+        master_solve_runtimes.emplace_back(std::chrono::steady_clock::now() - incumbent_watch.solve_start);
+        master_nodes.emplace_back(masterCplex.getNnodes());
+        cout << "master MILP (" << frog_options.switch_model << " switches): " << masterCplex.getNrows() << " rows, " << masterCplex.getNcols() << " columns ("
+             << masterCplex.getNbinVars() << " binary), " << masterCplex.getNNZs() << " non-zeros, " << master_nodes.back() << " nodes, "
+             << master_solve_runtimes.back().count() * 1000 << " ms\n";
+        if (solved && masterCplex.getStatus() != IloAlgorithm::Optimal)
+        {
+            incumbent_watch.deadline_reached = true;
+            cout << "master stopped at its " << budget * 1000 << " ms budget, publishing incumbent " << incumbent_watch.best_objective
+                 << " (" << incumbent_watch.incumbents << " incumbents, gap " << masterCplex.getMIPRelativeGap() << ")\n";
+        }
+        has_previous_solution = has_previous_solution || solved; // master() copies the solution into w_s_cl_sol / v_c_sol
+
+        cout << "master MIP start: " << (!mip_start_added ? "none" : incumbent_watch.from_mip_start ? "accepted" : "rejected");
+        if (incumbent_watch.found)
         {
-            N_max = v_bar_i;
+            cout << ", first incumbent after " << incumbent_watch.first_incumbent_ms << " ms";
+            if (mip_start_added && cold_first_incumbent_ms >= 0)
+                cout << " (" << cold_first_incumbent_ms - incumbent_watch.first_incumbent_ms << " ms saved against last cold start)";
+            if (!mip_start_added)
+                cold_first_incumbent_ms = incumbent_watch.first_incumbent_ms;
         }
+        cout << "\n";
+        solve_count++;
+        return solved;
     }
-    N_max += 1;
-    // cout << "N_max: " << N_max << "\n";
-    for (int i = 0; i < requests_qty; i++)
+
+    // writes this cycle's constants into the live model and frees w_s_cl bounds fixed in the previous cycle
+    void update(const Demand_Model &b_bar_cl, int phi_c, int segment_index)
     {
-        int v_bar_i = v_bar_c[i];
-        // cout << "v_bar_i" << v_bar_i << "\n";
-        int phi_i = phi_c; 
+        int srv_qty = net_topo.srv_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
 
-        masterConst7_RangeArr2[i] = (0 <= N_c[i] * N_max - (v_bar_i + v_c[i]));
-        // cout << "masterConst7_RangeArr2[" << i << "]: " << masterConst7_RangeArr2[i] << "\n";
-    }
+        double T_max = 0.0;
+        int I_max = 0;
+        int N_max = 0;
+        for (int i = 0; i < requests_qty; i++)
+        {
+            T_max = std::max(T_max, (lambda_bar_c[i] + m_c) / double(phi_c));
+            I_max = std::max(I_max, mu_bar_c[i] + m_c);
+            N_max = std::max(N_max, v_bar_c[i]);
+        }
+        N_max += 1;
+        double T_norm = phi_c * T_max;
+        bool first_segment = segment_index == 0; // constraints 6 and 7 are not used for the first segment
 
-    // master problem constraint (8)
-    for (int i = 0; i < requests_qty; i++)
-    { // each client (request)
-        layer_qty = m_c;
-        int lambda_bar_i = lambda_bar_c[i];
-        int phi_i = phi_c;
-        IloExpr master_const8_expr(masterEnv);
-        for (int j = 0; j < layer_qty; j++)
-        { // each layer of request
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            { // each server - e array's first srv_qty element contains servers. so loop starts from 0
-                master_const8_expr += w_s_cl[i][j][k];
+        for (int i = 0; i < requests_qty; i++)
+        {
+            for (int j = 0; j < m_c; j++)
+            {
+                for (int k = 0; k < srv_qty; k++)
+                {
+                    w_s_cl[i][j][k].setBounds(0, a_s_cl);
+                }
+            }
+            masterConst5_RangeArr[i].setLinearCoef(q_c[i], -1.0 / T_norm);
+            masterConst5_RangeArr[i].setBounds(lambda_bar_c[i] / T_norm, lambda_bar_c[i] / T_norm);
+            quality_change_RangeArr[i].setBounds(-l_bar_c[i], -l_bar_c[i]);
+            masterConst6_RangeArr[i].setLinearCoef(I_c[i], I_max);
+            masterConst6_RangeArr[i].setLB(first_segment ? -IloInfinity : mu_bar_c[i]);
+            masterConst7_RangeArr1[i].setLB(first_segment ? -IloInfinity : 0);
+            masterConst7_RangeArr2[i].setLinearCoef(N_c[i], N_max);
+            masterConst7_RangeArr2[i].setLB(first_segment ? -IloInfinity : v_bar_c[i]);
+            masterConst8_RangeArr[i].setLinearCoef(q_c[i], 1.0 / T_norm);
+            masterConst8_RangeArr[i].setLB(1.0 - lambda_bar_c[i] / T_norm);
+
+            if (!w_relaxations.empty())
+            {
+                bool rates_increase = true;
+                for (int j = 1; j + 1 < m_c; j++) // base layer is always in
+                    rates_increase = rates_increase && b_bar_cl[i][j] <= b_bar_cl[i][j + 1];
+                if (rates_increase && !w_relaxed[i])
+                    model.add(w_relaxations[i]);
+                else if (!rates_increase && w_relaxed[i])
+                    model.remove(w_relaxations[i]);
+                w_relaxed[i] = rates_increase;
             }
         }
-        masterConst8_RangeArr[i] = (L + ((master_const8_expr + lambda_bar_i) / (phi_i * T_max)) >= 1.0);
-        master_const8_expr.end();
-    } // master problem constraint (4)
 
-    /*
-            if(segment_index == 0){
+        for (int s = 0; s < sssw_qty; s++)
+        {
+            auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[s + srv_qty];
+            for (int y = 0; y < cssw_qty; y++)
+            {
+                sssw_cssw_rate_ranges[s][y].setUB(IloInfinity);
+                for (int c : net_topo.client_attachments[y].clients)
+                {
+                    for (int l = 0; l < m_c; l++)
+                    {
+                        double buffer_priority = 1.0;
+                        for (auto srv : connected_servers)
+                        {
+                            sssw_cssw_rate_ranges[s][y].setLinearCoef(w_s_cl[c][l][srv], buffer_priority * b_bar_cl[c][l]);
+                        }
+                    }
+                }
+            }
+        }
+    } // end of update()
 
-            }else{
+    // Called by master() after it fixed w bounds for this cycle. Fixings are carried through CONST 1 (a layer served by a server is 0 on
+    // the others) and CONST 3 (layers above a layer no server can serve are 0). Rate rows with no RHS, or whose free columns are all
+    // fixed and which hold, are taken out of the model and put back when they bind again. Fixed columns stay in the model with
+    // LB == UB, CPLEX's presolve drops them without any Concert change.
+    void presolve(const Demand_Model &b_bar_cl)
+    {
+        int srv_qty = net_topo.srv_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
+        int fixed_cols = 0;
+        int propagated_cols = 0;
+        for (int c = 0; c < requests_qty; c++)
+        {
+            bool layer_closed = false; // a lower layer of c can't be served
+            for (int l = 0; l < m_c; l++)
+            {
+                int served_by = -1;
+                bool servable = false;
+                for (int s = 0; s < srv_qty; s++)
+                {
+                    if (w_s_cl[c][l][s].getLB() == 1)
+                        served_by = s;
+                    servable = servable || w_s_cl[c][l][s].getUB() == 1;
+                }
+                for (int s = 0; s < srv_qty; s++)
+                {
+                    IloIntVar &w = w_s_cl[c][l][s];
+                    if (w.getUB() == 1 && w.getLB() == 0 && (layer_closed || (served_by != -1 && served_by != s)))
+                    {
+                        w.setBounds(0, 0);
+                        propagated_cols++;
+                    }
+                    fixed_cols += w.getLB() == w.getUB();
+                }
+                layer_closed = layer_closed || !servable;
+            }
+        }
 
+        int removed_rows = 0;
+        int added_rows = 0;
+        for (int s = 0; s < sssw_qty; s++)
+        {
+            auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[s + srv_qty];
+            for (int y = 0; y < cssw_qty; y++)
+            {
+                IloRange &range = sssw_cssw_rate_ranges[s][y];
+                bool binding = range.getUB() < IloInfinity;
+                if (binding)
+                {
+                    bool has_free_col = false;
+                    double fixed_rate = 0;
+                    for (int c : net_topo.client_attachments[y].clients)
+                    {
+                        for (int l = 0; l < m_c && !has_free_col; l++)
+                        {
+                            for (auto srv : connected_servers)
+                            {
+                                has_free_col = has_free_col || w_s_cl[c][l][srv].getLB() != w_s_cl[c][l][srv].getUB();
+                                fixed_rate += w_s_cl[c][l][srv].getLB() * b_bar_cl[c][l];
+                            }
+                        }
+                    }
+                    binding = has_free_col || fixed_rate > range.getUB(); // a violated constant row is kept so the solve reports it
+                }
+                if (binding && !rate_range_in_model[s][y])
+                {
+                    model.add(range);
+                    added_rows++;
+                }
+                else if (!binding && rate_range_in_model[s][y])
+                {
+                    model.remove(range);
+                }
+                removed_rows += !binding;
+                rate_range_in_model[s][y] = binding;
             }
-      */
-    // if (l_bar_c[client_ip] == 0) l_bar_c[client_ip] = w_s_c_l_sol_for_i;//first segment exception
-    // end of master problem constraint (6)
+        }
+        cout << "master presolve: " << removed_rows << "/" << sssw_qty * cssw_qty << " rate rows out of the model (" << added_rows << " added back), "
+             << fixed_cols << "/" << requests_qty * m_c * srv_qty << " w columns fixed (" << propagated_cols << " by propagation)\n";
+    }
+
+    // --quality-model=integer: w_s_cl_sol of clients with relaxed w is set to the prefix of their q_c
+    void round_to_quality()
+    {
+        for (int i = 0; i < requests_qty && !w_relaxations.empty(); i++)
+        {
+            if (!w_relaxed[i])
+                continue;
+            int q = IloRound(masterCplex.getValue(q_c[i]));
+            for (int j = 0; j < m_c; j++)
+                w_s_cl_sol[i][j][0] = j < q ? 1 : 0;
+        }
+    }
+}; // end of class Master_MILP
 
-} // End of masterInitBuilder
+// Sorting r_sc_sol according to bit rate ascending order. For each cssw, sending sssws are kept from the smallest r_sc to the biggest.
+void sort_r_sc_sol(IloNumArray2 &r_sc_sol, int sssw_qty, int cssw_qty, std::map<int, std::vector<int>> &sorted_r_sc_sol)
+{
+    std::vector<std::vector<int>> r_sc_sol_sort_indicator(sssw_qty, std::vector<int>(cssw_qty, 0));
+    for (int cssw = 0; cssw < cssw_qty; cssw++) // her bir cssw için göndersici sssw'lerin r_sc'leri indexlerine göre sort ediliyor.
+    {
+        for (int sssw1 = 0; sssw1 < sssw_qty; sssw1++)
+        {
+            int min_r_sc_sol = std::numeric_limits<int>::max();
+            int s;
+            for (int sssw2 = 0; sssw2 < sssw_qty; sssw2++)
+            {
+                if (r_sc_sol_sort_indicator[sssw2][cssw] == 0)
+                {
+                    if (min_r_sc_sol > r_sc_sol[sssw2][cssw])
+                    {
+                        min_r_sc_sol = r_sc_sol[sssw2][cssw];
+                        s = sssw2;
+                    }
+                }
+            }
+            r_sc_sol_sort_indicator[s][cssw] = 1;
+            sorted_r_sc_sol[cssw].emplace_back(s);
+        }
+    }
+}
 
 //This function is explained as OPM in paper
-void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, IloNumVar Q, IloNumVar L, IloNumVarArray T_c, IloNumVarArray I_c, IloIntVarArray v_c, IloIntArray v_c_sol, IloNumVarArray N_c,
-            int requests_qty, vector2d &b_bar_cl, Net_Topo &net_topo, int m_c, int a_s_cl,
-            IloExpr masterOptConstExpr, IloArray<IloRangeArray> masterConst1_RangeArr, IloArray<IloArray<IloRangeArray>> masterConst2_RangeArr, IloArray<IloRangeArray> masterConst3_RangeArr,
-            IloRangeArray masterConst4_RangeArr1, IloRangeArray masterConst4_RangeArr2, IloRangeArray masterConst5_RangeArr, IloRangeArray masterConst6_RangeArr, IloRangeArray masterConst7_RangeArr1,
-            IloRangeArray masterConst7_RangeArr2, IloRangeArray masterConst8_RangeArr,
+void master(Master_MILP &master_milp, int requests_qty, const Demand_Model &b_bar_cl, Net_Topo &net_topo, int m_c, int phi_c,
             int &total_w_s_cl_ub, int &total_w_s_cl_max, IloNumArray2 &r_sc_sol, IloNumArray2 &r_sc_gamma_sol, const int &counter,
             std::map<int, double> &req_max_rates_from_cssws, IloNumArray2 &gamma_ij_sol, vector<vector<int>> &r_sc_w_s_cl_count, IloRangeArray &master_FeasCutArray, std::map<int, std::vector<int>> &sorted_r_sc_sol, std::set<int> &sending_sssws, std::vector<std::vector<int>> &combinations, int &nCr_counter, int &r_value, int &addition_to_sub_layer,
             bool &need_inc_add_sub_layer, int &inc_cancelled, vector<double> &provided_rate_for_c, bool &dec_buff_for_master, int &total_w_s_cl_result, bool &master_solved,
@@ -1350,22 +4578,20 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
 {
     try
     {
-        IloModel masterMod(masterEnv, "masterMod");
+        IloEnv masterEnv = master_milp.env;
+        IloIntVarArray3 &w_s_cl = master_milp.w_s_cl;
+        IloNumArray3 &w_s_cl_sol = master_milp.w_s_cl_sol;
+        IloIntVarArray &v_c = master_milp.v_c;
+        IloIntArray &v_c_sol = master_milp.v_c_sol;
+        IloCplex &masterCplex = master_milp.masterCplex;
         int layer_qty;
         int srv_qty = net_topo.srv_qty;
         int sw_qty = net_topo.sw_qty;
         int cssw_qty = net_topo.ClientSideOFSWs.size();
         int sssw_qty = net_topo.ServerSideOFSWs.size();
 
-        IloExpr T_cs(masterEnv);
-        IloExpr I_cs(masterEnv);
-        IloExpr N_cs(masterEnv);
-        for (int i = 0; i < requests_qty; i++)
-        {
-            T_cs += -T_c[i]; // to maximize T_c, multibled by negative coefficent
-            I_cs += I_c[i];
-            N_cs += N_c[i];
-        }
+        auto update_start_time = std::chrono::steady_clock::now();
+        master_milp.update(b_bar_cl, phi_c, segment_index);
 
         std::vector<int> senders_qty(cssw_qty);
         //cout << "counter:----------------------------> " << counter << "\n";
@@ -1384,14 +4610,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
             }
             */
             // calculating cssw's required max data rates
-            int requested_rate = 0;
-            for (int c = 0; c < net_topo.requests_qty; c++)
-            {
-                for (int l = 0; l < m_c; l++)
-                {
-                    requested_rate += b_bar_cl[c][l]; // requested files from c * file size / TETA
-                }
-            }
+            int requested_rate = b_bar_cl.total_rate(); // requested files of clients * file size / TETA
 
             for (int c = 0; c < cssw_qty; c++)
             {
@@ -1406,28 +4625,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
             }
 
             //---------------Sorting r_sc_sol according to bit rate ascending order
-            std::vector<std::vector<int>> r_sc_sol_sort_indicator(sssw_qty, std::vector<int>(cssw_qty, 0));
-            for (int cssw = 0; cssw < cssw_qty; cssw++) // her bir cssw için göndersici sssw'lerin r_sc'leri indexlerine göre sort ediliyor.
-            {
-                for (int sssw1 = 0; sssw1 < sssw_qty; sssw1++)
-                {
-                    int min_r_sc_sol = std::numeric_limits<int>::max();
-                    int s;
-                    for (int sssw2 = 0; sssw2 < sssw_qty; sssw2++)
-                    {
-                        if (r_sc_sol_sort_indicator[sssw2][cssw] == 0)
-                        {
-                            if (min_r_sc_sol > r_sc_sol[sssw2][cssw])
-                            {
-                                min_r_sc_sol = r_sc_sol[sssw2][cssw];
-                                s = sssw2;
-                            }
-                        }
-                    }
-                    r_sc_sol_sort_indicator[s][cssw] = 1;
-                    sorted_r_sc_sol[cssw].emplace_back(s);
-                }
-            }
+            sort_r_sc_sol(r_sc_sol, sssw_qty, cssw_qty, sorted_r_sc_sol);
             /*
             for (auto element : sorted_r_sc_sol)
             {
@@ -1443,7 +4641,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
             // int sssw_counter = 0; // KALDIRILACAK
             int count_w_s_cl_0s = 0;
             cout << "requests_qty: " << requests_qty << "\n";
-            for (auto c_s : sorted_r_sc_sol)
+            for (auto &c_s : sorted_r_sc_sol)
             {
                 for (int s_sssw : c_s.second)
                 {
@@ -1451,7 +4649,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                     if (s_sssw == *(c_s.second.rbegin()))
                         break; // last sssw is not traveresed so it's ws will be assigned with MILP to keep QoE fairness properties.
                     int s_cssw = c_s.first;
-                    auto sssw_itr = net_topo.ServerSideOFSWs_Connected_Servers.find(s_sssw + srv_qty);
+                    auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[s_sssw + srv_qty];
 
                     if (r_sc_sol[s_sssw][s_cssw] == 0)
                     { // if there is no data to send from this sssw to cssw
@@ -1459,14 +4657,14 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                         {
                             // find c's cssw
                             // int cssw = net_topo.client_ip_con_sw_e_index[requests[c]->get_endpoint().address().to_string()] - srv_qty - net_topo.OF_SWs.size(); // client's r_sc index which client connected
-                            int cssw = 0;
+                            int cssw = net_topo.client_cssw[c];
                             if (cssw == s_cssw) // client'ın bağlı olduğu sw ile işlem yapılan sw (s_cssw) aynı ise
                             {
                                 // cout << "cssw == s_cssw\n";
                                 layer_qty = m_c;
                                 for (int l = 0; l < layer_qty; l++)
                                 {
-                                    for (auto s : sssw_itr->second) // iterating connected servers at this sssw
+                                    for (auto s : connected_servers) // iterating connected servers at this sssw
                                     {
                                         w_s_cl[c][l][s].setBounds(0, 0);
                                         count_w_s_cl_0s++;
@@ -1490,14 +4688,11 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                         // cout << "gamma_usage_percent 1: " << gamma_usage_percent << "\n";
 
                         // finds total gamma
-                        auto i = net_topo.Server_OF_SWs_Connections.find(s_sssw + net_topo.srv_qty);
+                        int i = s_sssw + net_topo.srv_qty;
                         double total_gamma = 0;
-                        if (i != net_topo.Server_OF_SWs_Connections.end())
+                        for (auto j : net_topo.Server_OF_SWs_Connections[i])
                         {
-                            for (auto j : i->second)
-                            {
-                                total_gamma += gamma_ij_sol[i->first][j];
-                            }
+                            total_gamma += gamma_ij_sol[i][j];
                         }
 
                         layer_qty = m_c;
@@ -1507,11 +4702,11 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                             for (int c = 0; c < requests_qty; c++)
                             {
                                 // int cssw = net_topo.client_ip_con_sw_e_index[requests[c]->get_endpoint().address().to_string()] - srv_qty - net_topo.OF_SWs.size(); // client's r_sc index which client connected
-                                int cssw = 0;
+                                int cssw = net_topo.client_cssw[c];
                                 // srv_qty + sw_qty - 1
                                 if (cssw == s_cssw) // client'ın bağlı olduğu sw ile işlem yapılan sw (s_cssw) aynı ise
                                 {
-                                    for (auto s : sssw_itr->second)
+                                    for (auto s : connected_servers)
                                     {
                                         // cout << "++++++++++++++++in else condition --- srv: " << s << "-->" << "sssw: " << sssw_itr->first - srv_qty << "\n";
                                         bool w_x_cl_is_set = false;
@@ -1554,83 +4749,17 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                             }
                         }
                     }
-                } // End of for(int sssw : c_s.second) --- to traverse all sssw for each cssw
-
-                auto last_s_sssw = *c_s.second.rbegin();
-                int s_cssw = c_s.first;
-                // auto sssw_itr = net_topo.ServerSideOFSWs_Connected_Servers.find(last_s_sssw + srv_qty);
-                sending_sssws.emplace(last_s_sssw);
-                IloExpr last_sssw_expr(masterEnv);
-
-                // finds gamma usage percentage
-                double gamma_usage_percent = 0.0;
-                double total_data_rate = 0.0;
-                for (int cssw = 0; cssw < cssw_qty; cssw++)
-                {
-                    total_data_rate += r_sc_sol[last_s_sssw][cssw];
-                }
-                gamma_usage_percent = r_sc_sol[last_s_sssw][s_cssw] / total_data_rate;
-                // cout << "gamma_usage_percent 2: " << gamma_usage_percent << "\n";
-
-                // finds total gamma
-                auto i = net_topo.Server_OF_SWs_Connections.find(last_s_sssw + net_topo.srv_qty);
-                double total_gamma = 0;
-                if (i != net_topo.Server_OF_SWs_Connections.end())
-                {
-                    for (auto j : i->second)
-                    {
-                        total_gamma += gamma_ij_sol[i->first][j];
-                    }
-                }
-
-                for (int c = 0; c < requests_qty; c++)
-                {
-                    //  find c's cssw
-                    // int cssw = net_topo.client_ip_con_sw_e_index[requests[c]->get_endpoint().address().to_string()] - srv_qty - net_topo.OF_SWs.size(); // client's r_sc index which client connected
-                    int cssw = 0;
-                    if (cssw == s_cssw)
-                    {
-                        layer_qty = m_c;
-                        for (int l = 0; l < layer_qty; l++)
-                        {
-                            auto sssw_itr = net_topo.ServerSideOFSWs_Connected_Servers.find(last_s_sssw + srv_qty);
-                            for (auto srv : sssw_itr->second)
-                            {
-                                bool w_x_cl_is_set = false;
-                                for (int s = 0; s < srv_qty; s++)
-                                {
-                                    if (w_s_cl[c][l][s].getLB() == 1 && w_s_cl[c][l][s].getUB() == 1)
-                                    {
-                                        w_x_cl_is_set = true;
-                                        break;
-                                    }
-                                }
-                                if (!w_x_cl_is_set) // kalan w_s_cl'ler için expression giriliyor.
-                                {
-                                    // cout << "last s - w_s_cl[" << srv << c << l << "] expression written\n";
-                                    double buffer_priority = 1.0;
-                                    /*
-                                    if (requests[c]->get_buffer() == 0)
-                                    {
-                                        buffer_priority = 1.2;
-                                    }
-                                    else if (requests[c]->get_buffer() == 1)
-                                    {
-                                        buffer_priority = 1.05;
-                                    }
-                                    */
-                                    last_sssw_expr += w_s_cl[c][l][srv] * buffer_priority * b_bar_cl[c][l];
-                                    // if (counter == 0)
-                                    //   r_sc_w_s_cl_count[last_s_sssw][s_cssw]++;
-                                }
-                            }
-                        }
-                    }
-                }
+                } // End of for(int sssw : c_s.second) --- to traverse all sssw for each cssw
+
+                auto last_s_sssw = *c_s.second.rbegin();
+                int s_cssw = c_s.first;
+                // auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[last_s_sssw + srv_qty];
+                sending_sssws.emplace(last_s_sssw);
+                // layers not fixed above are served by last sssw's servers in the limit of r_sc. Fixed layers get w = 0 on
+                // these servers by constraint 1, so the row's sum over all of its clients' layers is the same as master's former expression.
                 cout << "r_sc_sol[" << last_s_sssw << "][" << s_cssw << "]" << r_sc_sol[last_s_sssw][s_cssw] << "\n";
-                masterMod.add(last_sssw_expr <= r_sc_sol[last_s_sssw][s_cssw]);
-                // masterMod.add(last_sssw_expr <= r_sc_sol[last_s_sssw][s_cssw] + ((total_gamma / 2) * gamma_usage_percent));
-                last_sssw_expr.end();
+                master_milp.sssw_cssw_rate_ranges[last_s_sssw][s_cssw].setUB(r_sc_sol[last_s_sssw][s_cssw]);
+                // master_milp.sssw_cssw_rate_ranges[last_s_sssw][s_cssw].setUB(r_sc_sol[last_s_sssw][s_cssw] + ((total_gamma / 2) * gamma_usage_percent));
                 /*
                 for (int s = 0; s < sssw_qty; s++)
                 {
@@ -1644,154 +4773,14 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
             } // End of for(auto c_s : sorted_r_sc_sol) --- to traverse all cssw
         } // End of if counter == 0
 
-        masterMod.add(IloMinimize(masterEnv, 30 * Q + (3 * I_cs + 7 * N_cs) / (double)requests_qty)); // OBJ FUNC - 30 client 1 server genelde bununla aldık
-
-        // master problem constraint (0)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            IloExpr master_const0_expr(masterEnv);
-
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            {
-                master_const0_expr += w_s_cl[i][0][k];
-            }
-            masterMod.add(master_const0_expr == 1);
-            master_const0_expr.end();
-        } // end of master problem constrain (0)
-
-        // master problem constraint (1)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            // layer_qty = m_c;
-            layer_qty = m_c;
-            for (int j = 0; j < layer_qty; j++)
-            {                                               // each layer of request
-                masterMod.add(masterConst1_RangeArr[i][j]); // CONST 1
-            }
-        } // end of master problem constrain (1)
-
-        // master problem constraint (2)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            layer_qty = m_c;
-            // layer_qty = b_bar_cl[i].size();
-            for (int j = 0; j < layer_qty; j++)
-            { // each layer of request
-                for (int k = 0; k < net_topo.srv_qty; k++)
-                { // each server - e array's first srv_qty element contains servers. so loop starts from 0
-                    masterMod.add(masterConst2_RangeArr[i][j][k]); 
-                }
-            }
-        } // end of master problem constrain (2)
-
-        // master problem constraint (3)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            layer_qty = m_c;
-            // layer_qty = b_bar_cl[i].size();
-            for (int j = 0; j < layer_qty - 1; j++)
-            { // each layer of request
-                masterMod.add(masterConst3_RangeArr[i][j]);
-            }
-        } // end of master problem constrain (3)
-
-        // master problem constrain (4)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            masterMod.add(masterConst4_RangeArr1[i]);
-            // masterMod.add(masterConst4_RangeArr2[i]);
-        } // master problem constrain (4)
-
-        // master problem constrain (5)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            masterMod.add(masterConst5_RangeArr[i]);
-        } // master problem constrain (5)
-
-        // master problem constrain (6)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            if (segment_index != 0)
-            {
-                try
-                {
-                    masterMod.add(masterConst6_RangeArr[i]);
-                }
-                catch (...)
-                {
-                    cout << "exeption throw - Contraint 6 !\n";
-                }
-                // if(masterConst6_RangeArr[i]) masterMod.add(masterConst6_RangeArr[i]);
-            }
-        } // master problem constrain (6)
-
-        // master problem constrain (7)
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            if (segment_index != 0)
-            {
-                try
-                {
-                    masterMod.add(masterConst7_RangeArr1[i]);
-                    masterMod.add(masterConst7_RangeArr2[i]);
-                }
-                catch (...)
-                {
-                    cout << "*********************************************************exeption throw - Contraint 7 - 1 or 2 !\n";
-                }
-            }
-        } // master problem constrain (7)
-
-        // master problem constraint (8) Long term QoE Fairness Constraint
-        for (int i = 0; i < requests_qty; i++)
-        { // each client (request)
-            masterMod.add(masterConst8_RangeArr[i]);
-        }
-        // masterConst8_RangeArr.end();
-        //  End of master problem constraint (8) Long term QoE Fairness Constraint
-
-        IloCplex masterCplex(masterMod);
-        masterCplex.setOut(masterEnv.getNullStream()); // Disable CPLEX logging
-        masterCplex.setWarning(masterEnv.getNullStream());
-        masterCplex.setParam(IloCplex::Param::TimeLimit, 1.0);
-
-
-    // 1. Set MIP strategy to traditional B&B (faster for small trees)
-    masterCplex.setParam(IloCplex::Param::MIP::Strategy::Search, 1);  // 1 = Traditional
-    
-    // 2. Set optimality gap tolerance to 1%
-    masterCplex.setParam(IloCplex::Param::MIP::Tolerances::MIPGap, 0.01);
-    
-    // 3. Balanced optimality/feasibility emphasis
-    masterCplex.setParam(IloCplex::Param::Emphasis::MIP, 1);  // 1 = Balanced
-    
-    // 4. Enable aggressive presolve
-    masterCplex.setParam(IloCplex::Param::Preprocessing::Presolve, 1);  // 1 = On
-    //masterCplex.setParam(IloCplex::Param::Preprocessing::Aggregate, 1); // 1 = On
-    masterCplex.setParam(IloCplex::Param::Preprocessing::Aggregator, 1); // 1 = On
-    
-    // 5. Parallel processing (4 threads)
-    masterCplex.setParam(IloCplex::Param::Threads, 4);
-    
-    // 6. Enable strong branching
-    masterCplex.setParam(IloCplex::Param::MIP::Strategy::VariableSelect, 3);  // 3 = Strong
-    
-    // 7. Set solution pool intensity (finds good solutions faster)
-    masterCplex.setParam(IloCplex::Param::MIP::Limits::Populate, 10);
-    masterCplex.setParam(IloCplex::Param::MIP::Pool::Intensity, 2);
-    
-    // 8. Enable RINS heuristic (finds integer solutions faster)
-    masterCplex.setParam(IloCplex::Param::MIP::Strategy::RINSHeur, 50);
-    
-    // 9. Additional tuning for large-scale problems
-    masterCplex.setParam(IloCplex::Param::MIP::Strategy::Probe, 3);  // Aggressive probing
-    masterCplex.setParam(IloCplex::Param::MIP::Cuts::MIRCut, 2);     // Aggressive MIR cuts
-    masterCplex.setParam(IloCplex::Param::MIP::Cuts::FlowCovers, 2); // Flow cover cuts
-
+        master_milp.presolve(b_bar_cl);
+        master_milp.add_mip_start(b_bar_cl, r_sc_sol, sorted_r_sc_sol, segment_index);
+        std::chrono::duration<double, std::milli> update_time = std::chrono::steady_clock::now() - update_start_time;
+        cout << "master MILP updated in " << update_time.count() << " ms (build " << master_milp.build_time.count() << " ms)\n";
 
-        if (masterCplex.solve())
+        if (master_milp.solve())
         {
-            masterCplex.exportModel("masterModel.lp");
+            // masterCplex.exportModel("masterModel.lp"); // writes the whole model at every cycle, enable only for debugging
             master_solved = true;
 
             IloAlgorithm::Status solStatus = masterCplex.getStatus();
@@ -1818,11 +4807,12 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                     masterCplex.getValue(v_c[i], v_c_sol[i]);
                 }
             }
+            master_milp.round_to_quality();
 
             // Updates r_sc_w_s_cl_count of biggest data sender r_sc
             if (counter == 0)
             {
-                for (auto c_s : sorted_r_sc_sol)
+                for (auto &c_s : sorted_r_sc_sol)
                 {
                     auto last_s_sssw = *c_s.second.rbegin();
                     int last_s_cssw = c_s.first;
@@ -1832,7 +4822,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                         for (int c = 0; c < requests_qty; c++)
                         {
                             // int cssw = net_topo.client_ip_con_sw_e_index[requests[c]->get_endpoint().address().to_string()] - srv_qty - net_topo.OF_SWs.size(); // client's r_sc index which client connected
-                            int cssw = 0;
+                            int cssw = net_topo.client_cssw[c];
                             if (last_s_sssw == sssw && last_s_cssw == cssw)
                             {
                                 for (int l = 0; l < layer_qty; l++)
@@ -1861,11 +4851,6 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
 
             total_w_s_cl_result = 0;
 
-            for (int i = 0; i < requests_qty; i++)
-            {
-                video_quality.emplace_back(vector<int>());
-            }
-
             // int w_result_k = 0;
             for (int i = 0; i < requests_qty; i++)
             {
@@ -1881,7 +4866,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
                     // cout << "client " << requests[i]->get_endpoint().address().to_string() << "'s w result in master from server "<< k << ": " << w_result_i << "\n";
                     // w_result_k += w_result_i;
                 }
-                video_quality[i].emplace_back(w_result_i);
+                metrics_store.set_quality(i, w_result_i);
                 // cout << " w results from server " << k << ": " << w_result_k << "\n";
             }
 
@@ -1908,6 +4893,7 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
         else
         {
             master_solved = false;
+            master_milp.clear_solution();
             masterEnv.out() << "Master: No solution available" << endl;
         }
         // Close the environment
@@ -1915,6 +4901,8 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
     catch (const IloException &e)
     {
         cerr << "Exception caught: " << e << endl;
+        master_solved = false;
+        master_milp.clear_solution();
         // Close the environment
     }
     catch (...)
@@ -1925,15 +4913,554 @@ void master(IloEnv masterEnv, IloIntVarArray3 w_s_cl, IloNumArray3 w_s_cl_sol, I
 }
 // end of master problem
 
+// Pre-assignment of non-last sssws, same order as master: layers of clients of each cssw are fixed to the servers of its sending
+// sssws (smallest r_sc first) while they fit r_sc, the last sssw's layers are left to the model.
+// w_fixed[(c * m_c + l) * srv_qty + s]: 1 = fixed to the server, 0 = forbidden, -1 = free
+void preassign_sssws(int requests_qty, const Demand_Model &b_bar_cl, Net_Topo &net_topo, int m_c, IloNumArray2 &r_sc_sol, const int &counter,
+                     vector<vector<int>> &r_sc_w_s_cl_count, std::map<int, std::vector<int>> &sorted_r_sc_sol, std::set<int> &sending_sssws,
+                     std::vector<int> &w_fixed, std::vector<int> &last_sssw_of_cssw)
+{
+    int srv_qty = net_topo.srv_qty;
+    int cssw_qty = net_topo.ClientSideOFSWs.size();
+    int sssw_qty = net_topo.ServerSideOFSWs.size();
+    w_fixed.assign(requests_qty * m_c * srv_qty, -1);
+    auto fixed = [&](int c, int l, int s) -> int &
+    { return w_fixed[(c * m_c + l) * srv_qty + s]; };
+    auto layer_is_set = [&](int c, int l)
+    {
+        for (int s = 0; s < srv_qty; s++)
+            if (fixed(c, l, s) == 1)
+                return true;
+        return false;
+    };
+
+    sort_r_sc_sol(r_sc_sol, sssw_qty, cssw_qty, sorted_r_sc_sol);
+    last_sssw_of_cssw.assign(cssw_qty, -1);
+    for (auto &c_s : sorted_r_sc_sol)
+    {
+        int s_cssw = c_s.first;
+        for (int s_sssw : c_s.second)
+        {
+            if (s_sssw == *(c_s.second.rbegin()))
+                break; // last sssw's layers are decided by the model
+            auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[s_sssw + srv_qty];
+            if (r_sc_sol[s_sssw][s_cssw] > 0)
+                sending_sssws.emplace(s_sssw);
+            double total_fixed_r_sc = 0;
+            for (int l = 0; l < m_c; l++)
+            {
+                for (int c : net_topo.client_attachments[s_cssw].clients)
+                {
+                    for (auto s : connected_servers)
+                    {
+                        if (r_sc_sol[s_sssw][s_cssw] == 0)
+                        {
+                            fixed(c, l, s) = 0;
+                            continue;
+                        }
+                        if (layer_is_set(c, l))
+                            continue;
+                        total_fixed_r_sc += b_bar_cl[c][l];
+                        if (total_fixed_r_sc <= r_sc_sol[s_sssw][s_cssw])
+                        {
+                            fixed(c, l, s) = 1;
+                            if (counter == 0)
+                                r_sc_w_s_cl_count[s_sssw][s_cssw]++;
+                        }
+                        else
+                            fixed(c, l, s) = 0;
+                    }
+                }
+            }
+        }
+        last_sssw_of_cssw[s_cssw] = *c_s.second.rbegin();
+        sending_sssws.emplace(last_sssw_of_cssw[s_cssw]);
+    }
+}
+
+// Class-aggregated version of master (--master=aggregated). Clients with the same cssw, layer sizes, history (lambda_bar_c, l_bar_c,
+// mu_bar_c, v_bar_c) and pre-assigned layers can't be told apart by the model, so they're grouped into classes and the MILP decides
+// how many clients of each class get quality q (x_kq integer counts) instead of deciding w_s_cl per client.
+// Q, I_c and N_c of master are expressed per (class, quality): I = (mu_bar + |q - l_bar|) / I_max, N = (v_bar + [q != l_bar]) / N_max.
+// T_c and L don't take part in master's objective and are always feasible, so they're left out. After solving, counts are
+// disaggregated back to w_s_cl_sol and v_c_sol in client order.
+void master_aggregated(Master_Results &master_results, int requests_qty, const Demand_Model &b_bar_cl, Net_Topo &net_topo, int m_c,
+                       IloNumArray2 &r_sc_sol, const int &counter, vector<vector<int>> &r_sc_w_s_cl_count, std::map<int, std::vector<int>> &sorted_r_sc_sol,
+                       std::set<int> &sending_sssws, int &total_w_s_cl_result, bool &master_solved, const int segment_index)
+{
+    IloEnv masterEnv; // the aggregated model is small, it's built in its own env at each cycle
+    IloNumArray3 &w_s_cl_sol = master_results.w_s_cl_sol;
+    IloIntArray &v_c_sol = master_results.v_c_sol;
+    try
+    {
+        int srv_qty = net_topo.srv_qty;
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
+
+        std::vector<int> w_fixed;
+        std::vector<int> last_sssw_of_cssw;
+        preassign_sssws(requests_qty, b_bar_cl, net_topo, m_c, r_sc_sol, counter, r_sc_w_s_cl_count, sorted_r_sc_sol, sending_sssws, w_fixed, last_sssw_of_cssw);
+        auto fixed = [&](int c, int l, int s) -> int &
+        { return w_fixed[(c * m_c + l) * srv_qty + s]; };
+        auto layer_is_set = [&](int c, int l)
+        {
+            for (int s = 0; s < srv_qty; s++)
+                if (fixed(c, l, s) == 1)
+                    return true;
+            return false;
+        };
+
+        // classes of identical clients
+        int I_max = 0; // same normalizers as masterInitBuilder
+        int N_max = 0;
+        for (int c = 0; c < requests_qty; c++)
+        {
+            I_max = std::max(I_max, mu_bar_c[c] + m_c);
+            N_max = std::max(N_max, v_bar_c[c]);
+        }
+        N_max += 1;
+
+        std::map<std::vector<double>, int> class_of_key;
+        std::vector<std::vector<int>> class_clients;
+        std::vector<double> key;
+        for (int c = 0; c < requests_qty; c++)
+        {
+            key.assign({(double)net_topo.client_cssw[c], (double)lambda_bar_c[c], (double)l_bar_c[c], (double)mu_bar_c[c], (double)v_bar_c[c]});
+            key.insert(key.end(), b_bar_cl[c].begin(), b_bar_cl[c].begin() + m_c);
+            for (int l = 0; l < m_c; l++)
+                for (int s = 0; s < srv_qty; s++)
+                    key.push_back(fixed(c, l, s));
+            auto class_itr = class_of_key.emplace(key, class_clients.size()).first;
+            if (class_itr->second == (int)class_clients.size())
+                class_clients.emplace_back();
+            class_clients[class_itr->second].push_back(c);
+        }
+        int class_qty = class_clients.size();
+        cout << "master aggregated " << requests_qty << " clients into " << class_qty << " classes\n";
+
+        IloModel masterMod(masterEnv, "masterAggMod");
+        IloNumVar Q(masterEnv, 0, 1);
+        IloIntVarArray z_q(masterEnv, m_c + 1, 0, 1); // whether quality q is given to any client
+        IloArray<IloIntVarArray> x_kq(masterEnv, class_qty);
+        IloExpr I_N_expr(masterEnv);
+        std::vector<IloExpr> cssw_rate_exprs;
+        for (int y = 0; y < cssw_qty; y++)
+            cssw_rate_exprs.emplace_back(masterEnv);
+
+        for (int k = 0; k < class_qty; k++)
+        {
+            int c = class_clients[k][0]; // representative client
+            int n_k = class_clients[k].size();
+            int cssw = net_topo.client_cssw[c];
+            int last_sssw = last_sssw_of_cssw[cssw];
+            bool last_has_servers = last_sssw >= 0 && net_topo.ServerSideOFSWs_Connected_Servers[last_sssw + srv_qty].size() > 0;
+
+            x_kq[k] = IloIntVarArray(masterEnv, m_c + 1, 0, n_k);
+            x_kq[k][0].setBounds(0, 0); // base layer is always given (constraint 0)
+            IloExpr class_expr(masterEnv);
+            double layer_rate = 0; // rate of q layers taken from last sssw
+            int fixed_layers = 0;
+            for (int q = 1; q <= m_c; q++)
+            {
+                int l = q - 1;
+                if (layer_is_set(c, l))
+                    fixed_layers = q;
+                else if (last_has_servers)
+                    layer_rate += b_bar_cl[c][l];
+                else
+                {
+                    for (int q2 = q; q2 <= m_c; q2++)
+                        x_kq[k][q2].setBounds(0, 0); // layer l has no server to come from
+                    break;
+                }
+                class_expr += x_kq[k][q];
+                masterMod.add(x_kq[k][q] <= n_k * z_q[q]);
+                cssw_rate_exprs[cssw] += layer_rate * x_kq[k][q];
+                if (segment_index != 0) // constraints 6 and 7 are used after the first segment
+                {
+                    int switch_size = std::abs(q - l_bar_c[c]);
+                    double I_k = (mu_bar_c[c] + switch_size) / (double)I_max;
+                    double N_k = (v_bar_c[c] + (switch_size > 0 ? 1 : 0)) / (double)N_max;
+                    I_N_expr += (3 * I_k + 7 * N_k) * x_kq[k][q];
+                }
+            }
+            for (int q = 1; q < fixed_layers; q++)
+                x_kq[k][q].setBounds(0, 0); // pre-assigned layers and the layers below them are given (constraint 3)
+            masterMod.add(class_expr == n_k);
+            class_expr.end();
+        }
+        for (int q = 1; q <= m_c; q++)
+            masterMod.add(Q >= (1.0 - q / (double)m_c) * z_q[q]); // constraint 4
+        for (int y = 0; y < cssw_qty; y++)
+        {
+            if (last_sssw_of_cssw[y] >= 0)
+                masterMod.add(cssw_rate_exprs[y] <= r_sc_sol[last_sssw_of_cssw[y]][y]);
+            cssw_rate_exprs[y].end();
+        }
+        masterMod.add(IloMinimize(masterEnv, 30 * Q + I_N_expr / (double)requests_qty));
+        I_N_expr.end();
+
+        IloCplex masterCplex(masterMod);
+        masterCplex.setOut(masterEnv.getNullStream()); // Disable CPLEX logging
+        masterCplex.setWarning(masterEnv.getNullStream());
+        masterCplex.setParam(IloCplex::Param::TimeLimit, master_results.time_budget());
+        masterCplex.setParam(IloCplex::Param::MIP::Tolerances::MIPGap, 0.01);
+        masterCplex.setParam(IloCplex::Param::Threads, 4);
+
+        if (masterCplex.solve())
+        {
+            master_solved = true;
+            masterEnv.out() << "Master (aggregated) Solution status: " << masterCplex.getStatus() << endl;
+
+            // disaggregation - clients of a class take qualities in client order, layers from last sssw are spread over its servers
+            std::vector<int> next_server(sssw_qty, 0);
+            total_w_s_cl_result = 0;
+            for (int k = 0; k < class_qty; k++)
+            {
+                int member = 0;
+                for (int q = m_c; q >= 1; q--)
+                {
+                    int x_count = IloRound(masterCplex.getValue(x_kq[k][q]));
+                    for (; x_count > 0 && member < (int)class_clients[k].size(); x_count--, member++)
+                    {
+                        int c = class_clients[k][member];
+                        int cssw = net_topo.client_cssw[c];
+                        int last_sssw = last_sssw_of_cssw[cssw];
+                        for (int l = 0; l < m_c; l++)
+                        {
+                            for (int s = 0; s < srv_qty; s++)
+                                w_s_cl_sol[c][l][s] = (l < q && fixed(c, l, s) == 1) ? 1 : 0;
+                            if (l >= q || layer_is_set(c, l))
+                                continue;
+                            auto connected_servers = net_topo.ServerSideOFSWs_Connected_Servers[last_sssw + srv_qty];
+                            int s = connected_servers.begin()[next_server[last_sssw]++ % connected_servers.size()];
+                            w_s_cl_sol[c][l][s] = 1;
+                            if (counter == 0)
+                                r_sc_w_s_cl_count[last_sssw][cssw]++;
+                        }
+                        if (segment_index != 0)
+                            v_c_sol[c] = (q != l_bar_c[c]) ? 1 : 0;
+                        total_w_s_cl_result += q;
+                        metrics_store.set_quality(c, q);
+                    }
+                }
+            }
+        }
+        else
+        {
+            master_solved = false;
+            master_results.clear_solution();
+            masterEnv.out() << "Master (aggregated): No solution available" << endl;
+        }
+    }
+    catch (const IloException &e)
+    {
+        cerr << "Exception caught: " << e << endl;
+        master_solved = false;
+        master_results.clear_solution();
+    }
+    masterEnv.end();
+}
+// end of class-aggregated master problem
+
+// Master engines built on Greedy_Master (--master=greedy|lagrangian|partitioned), for client quantities master's MILP can't solve within a cycle
+void master_greedy(Master_Results &master_results, Greedy_Master &greedy, int requests_qty, const Demand_Model &b_bar_cl, Net_Topo &net_topo, int m_c,
+                   IloNumArray2 &r_sc_sol, const int &counter, vector<vector<int>> &r_sc_w_s_cl_count, std::map<int, std::vector<int>> &sorted_r_sc_sol,
+                   std::set<int> &sending_sssws, int &total_w_s_cl_result, bool &master_solved, const int segment_index)
+{
+    IloNumArray3 &w_s_cl_sol = master_results.w_s_cl_sol;
+    IloIntArray &v_c_sol = master_results.v_c_sol;
+    int srv_qty = net_topo.srv_qty;
+
+    std::vector<int> w_fixed;
+    std::vector<int> last_sssw_of_cssw;
+    preassign_sssws(requests_qty, b_bar_cl, net_topo, m_c, r_sc_sol, counter, r_sc_w_s_cl_count, sorted_r_sc_sol, sending_sssws, w_fixed, last_sssw_of_cssw);
+
+    greedy.time_budget = master_results.time_budget();
+    master_solved = greedy.solve(b_bar_cl, r_sc_sol, w_fixed, last_sssw_of_cssw, segment_index);
+    greedy.report(("master (" + frog_options.master_model + ")").c_str());
+    if (!master_solved)
+    {
+        cout << "Master (greedy): No solution available" << endl;
+        master_results.clear_solution();
+        return;
+    }
+
+    total_w_s_cl_result = 0;
+    for (int c = 0; c < requests_qty; c++)
+    {
+        int cssw = net_topo.client_cssw[c];
+        for (int l = 0; l < m_c; l++)
+        {
+            int server = greedy.layer_server[c * m_c + l];
+            for (int s = 0; s < srv_qty; s++)
+                w_s_cl_sol[c][l][s] = s == server ? 1 : 0;
+            if (server >= 0 && w_fixed[(c * m_c + l) * srv_qty + server] != 1 && counter == 0)
+                r_sc_w_s_cl_count[last_sssw_of_cssw[cssw]][cssw]++;
+        }
+        if (segment_index != 0)
+            v_c_sol[c] = (greedy.quality[c] != l_bar_c[c]) ? 1 : 0;
+        total_w_s_cl_result += greedy.quality[c];
+        metrics_store.set_quality(c, greedy.quality[c]);
+    }
+}
+// end of MILP-free master
+
+// Segment's demand vectors, prepared ahead of its cycle by optimizer()'s prepare stage
+struct Segment_Input
+{
+    int segment_index = 0;
+    Demand_Model b_bar_cl;
+    int total_w_s_cl_max = 0;
+};
+
+// layer l of client c is sent from sssw's servers on a path of the sssw-cssw flow. Publish writes one rule per hop, the path's
+// edges stay in the solve stage's Path_Table.
+struct Flow_Rule
+{
+    int c;
+    int l;
+    int sssw;
+    int hop_qty;
+};
+
+// What the publish stage needs from a solved cycle. It's a copy, the solve stage goes on with the next segment meanwhile.
+// Jobs are sent back to the solve stage after publish and reused, their buffers keep their capacity.
+struct Publish_Job
+{
+    int segment_index = 0;
+    int m_c = 0;
+    bool solution_found = true;
+    int priority = 0;
+    std::chrono::steady_clock::time_point cycle_start;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::duration<double> packing_time{0};
+    float phase_ms[Metrics_Store::phase_qty] = {}; // filled in by the solve stage except flow assignment and publish
+    std::vector<Flow_Rule> flow_rules;
+    std::vector<int> quality;       // layer qty of c
+    std::vector<int> layer_servers; // server of layer l of c at c * m_c + l, -1 if none
+};
+
+// Prints the segments kept in the metrics store, also while its optimizer is writing it (--metrics-read=<file>)
+void print_metrics(const Metrics_Store &store)
+{
+    int64_t last = store.last_segment();
+    int64_t first = std::max<int64_t>(0, last - store.capacity() + 1);
+    std::vector<int64_t> segments;
+    std::vector<std::vector<uint8_t>> qualities;
+    std::vector<std::array<float, Metrics_Store::phase_qty>> timings;
+    float phase_ms[Metrics_Store::phase_qty];
+    std::vector<uint8_t> quality;
+    for (int64_t segment = first; segment <= last; segment++)
+    {
+        if (!store.read_segment(segment, phase_ms, quality))
+            continue; // overwritten while it's read
+        segments.emplace_back(segment);
+        qualities.emplace_back(quality);
+        timings.emplace_back();
+        std::copy(phase_ms, phase_ms + Metrics_Store::phase_qty, timings.back().begin());
+    }
+
+    cout << "Segments:";
+    for (auto segment : segments)
+        cout << "\t" << segment;
+    cout << "\n";
+    const char *phase_names[Metrics_Store::phase_qty] = {"multiserver ms", "master ms", "flow assignment ms", "cycle ms", "publish latency ms", "master nodes"};
+    for (int p = 0; p < Metrics_Store::phase_qty; p++)
+    {
+        cout << phase_names[p] << ":";
+        for (auto &timing : timings)
+            cout << "\t" << timing[p];
+        cout << "\n";
+    }
+    cout << "\n";
+    cout << "Video Quality:\n";
+    for (int i = 0; i < store.clients(); i++)
+    {
+        for (auto &segment_quality : qualities)
+        {
+            cout << (int)segment_quality[i] << "\t";
+        }
+        cout << "\n";
+    }
+    cout << "\n";
+    cout << "\n";
+}
+
+// Serializes flow rules for the controller and layer messages for clients of a solved segment
+void publish(Publish_Job &job, Net_Topo &net_topo, Json::Value &json_flows, Json::Value &json_flow_srv_src, Json::Value &json_messages, Json::Value &json_message)
+{
+    int segment_index = job.segment_index;
+    if (job.solution_found)
+    {
+        json_flow_srv_src["priority"] = job.priority;
+        int flow_counter = 0;
+        json_flows.clear();
+        json_messages.clear();
+        for (size_t r = 0; r < job.flow_rules.size(); r++)
+        {
+            Flow_Rule &flow_rule = job.flow_rules[r];
+            std::string srv_ip = net_topo.srv_e_index_ip[flow_rule.sssw];
+            // json_flow_srv_dst["selector"]["criteria"][4]["type"] = "TCP_DST";
+            // json_flow_srv_dst["selector"]["criteria"][4]["tcpPort"] = TCP_PORTS[port_change_flag][layer]; // port_change_flag variable fixed as 0. Bacause I deciced to use only one TCP port set on server side as consequence of deciding that clients send sequential http requests to servers.
+            json_flow_srv_src["selector"]["criteria"][4]["type"] = "TCP_SRC";
+            json_flow_srv_src["selector"]["criteria"][4]["tcpPort"] = 8000 + flow_rule.l;
+
+            std::string client_ip = "10." + std::string("1.") + std::to_string(flow_rule.c / 256) + "." + std::to_string(flow_rule.c % 256);
+
+            for (int hop = 0; hop < flow_rule.hop_qty; hop++) // one rule per edge of the path
+            {
+                json_flow_srv_src["deviceId"] = "of:"; //+ net_topo.sw_e_index_id.find(current_sw)->second;         // DeviceId is added to flow text
+
+                json_flow_srv_src["treatment"]["instructions"][0]["port"] = "1";        // net_topo.ports[current_sw][next_sw]; // output port added
+                json_flow_srv_src["selector"]["criteria"][1]["ip"] = srv_ip + "/32";    // IPV4_SRC - Server IP
+                json_flow_srv_src["selector"]["criteria"][2]["ip"] = client_ip + "/32"; // IPV4_DST - Client IP
+                json_flows["flows"][flow_counter++] = json_flow_srv_src;
+            }
+        }
+
+        Json::FastWriter fastWriter;
+        std::string flows = fastWriter.write(json_flows);
+        // net_topo.add_flow(flows);
+
+        //cout << "json messages - start\n";
+        for (int i = 0; i < net_topo.requests_qty; ++i)
+        {
+            std::string client_ip = "10." + std::string("1.") + std::to_string(i / 256) + "." + std::to_string(i % 256);
+
+            // string client_ip = requests[i]->get_endpoint().address().to_string(); // Client IP
+            int w_s_c_l_sol_for_i = job.quality[i]; // result of optimization of layer quality for c's requested segment
+
+            json_messages.clear();
+
+            for (int layer = 0; layer < w_s_c_l_sol_for_i; ++layer)
+            {
+                json_message["layer"] = layer; // message to client for layer info
+                json_message["tcp_port"] = (8000 + layer);
+
+                int s = job.layer_servers[i * job.m_c + layer];
+                if (s >= 0)
+                {
+                    std::string srv_ip = net_topo.srv_e_index_ip[s];
+                    // cout << "srv_ip: " << srv_ip << "\n";
+                    json_message["server_ip"] = srv_ip; // message prepperation to client
+                }
+                json_messages["msgs"][layer] = json_message;
+            }
+
+            // json_messages["indx"] = requests[i]->get_seg_index();
+            json_messages["indx"] = segment_index;
+            json_messages["buf"] = 0;
+            json_messages["ip"] = client_ip;
+
+            if (w_s_c_l_sol_for_i == 0)
+            {
+                string srv_ip;
+                if (srv_ip == "")
+                {
+                    auto itr = net_topo.servers.begin();
+                    std::advance(itr, (i % net_topo.servers.size()));
+
+                    // string ip = *itr;
+                    srv_ip = *itr;
+                    // cout << "server ip: " << srv_ip << "\n";
+                }
+                json_message["layer"] = 0; // message to client for layer info
+                json_message["layer_qty"] = 1;
+                json_message["tcp_port"] = 8000;
+                json_message["server_ip"] = srv_ip; // preferred or previous iteration server ip
+
+                json_messages["msgs"][0] = json_message;
+                // cout << "sol is 0 - json_message: " << json_message << "\n";
+                json_messages["indx"] = segment_index;
+                json_messages["buf"] = 0;
+                json_messages["ip"] = client_ip;
+            }
+
+            std::string messages = fastWriter.write(json_messages); // json to string conversion - message to client{"layer_qty":int, "tcp_port":int}
+        } // end of for of requests
+        //cout << "json messages - end\n";
+    }
+    else
+    {
+        // BU ALANA CLIENT İÇİN DÖNÜŞ BİLGİSİ KODLAMASI YAPILACAK.
+        cout << "NO SOLUTION AVAIABLE! --- SENDING BASE LAYER INFO\n";
+        cout << "net_topo.srv_qty: " << net_topo.srv_qty << "\n";
+
+        for (int i = 0; i < net_topo.requests_qty; ++i)
+        {
+            // message preperation to client
+            json_messages.clear();
+            std::string client_ip = "10." + std::string("1.") + std::to_string(i / 256) + "." + std::to_string(i % 256);
+
+            // std::string srv_ip = requests[i]->get_srv_ip();
+            std::string srv_ip = "10.0.0.200";
+
+            if (srv_ip == "")
+            {
+                auto itr = net_topo.servers.begin();
+                std::advance(itr, (i % net_topo.servers.size()));
+                srv_ip = *itr;
+            }
+            json_message["layer"] = 0; // message to client for layer info
+            json_message["tcp_port"] = 8000;
+            json_message["server_ip"] = srv_ip; // preferred or previous iteration server ip
+
+            json_messages["msgs"][0] = json_message;
+            json_messages["indx"] = segment_index;
+            json_messages["buf"] = 0;
+            json_messages["ip"] = client_ip;
+            Json::FastWriter fastWriter;
+            std::string message = fastWriter.write(json_messages); // json to string conversion - message to client{"layer_qty":int, "tcp_port":int}
+            // requests[i]->post(message);
+        } // end of for of requests
+    }
+}
+
 void optimizer()
 {
-    Net_Topo net_topo;
+    Net_Topo net_topo(frog_options.requests_qty, frog_options.topology_file);
+    std::unique_ptr<Multiserver_Live_LP> multiserver_lp;            // built once, patched with topology deltas
+    Multiserver_Path_LP *multiserver_path_lp = nullptr;             // --lp-solver=paths, owned by multiserver_lp
+    std::unique_ptr<Multiserver_Native> multiserver_native_engine; // --lp-solver=native
+    if (frog_options.lp_solver == "native")
+        multiserver_native_engine.reset(new Multiserver_Native(net_topo));
+    else if (frog_options.lp_solver == "paths")
+        multiserver_lp.reset(multiserver_path_lp = new Multiserver_Path_LP(net_topo, frog_options.k_paths));
+    else
+        multiserver_lp.reset(new Multiserver_LP(net_topo));
+    Multiserver_Results &multiserver_results = multiserver_lp ? static_cast<Multiserver_Results &>(*multiserver_lp) : *multiserver_native_engine;
+    Path_Table path_table; // flow paths of each cycle, its buffers are reused
+    metrics_store.open(frog_options.requests_qty, frog_options.history, frog_options.metrics_file);
     int interval = 2000;
     int const m_c = 4; // max layer m_c
+    std::unique_ptr<Master_MILP> master_milp;           // per client master, built once and updated at each cycle
+    std::unique_ptr<Master_Results> master_agg_results; // --master=aggregated builds its small model at each cycle, --master=greedy has no model
+    if (frog_options.master_model != "full")
+        master_agg_results.reset(new Master_Results(net_topo.requests_qty, m_c, net_topo.srv_qty));
+    else
+        master_milp.reset(new Master_MILP(net_topo, m_c));
+    Master_Results &master_results = master_milp ? static_cast<Master_Results &>(*master_milp) : *master_agg_results;
+    std::unique_ptr<Thread_Pool> thread_pool;
+    std::unique_ptr<Greedy_Master> master_engine; // --master=greedy|lagrangian|partitioned, kept for lagrangian's multipliers
+    if (frog_options.master_model == "lagrangian" || frog_options.master_model == "partitioned")
+        thread_pool.reset(new Thread_Pool(frog_options.threads > 0 ? frog_options.threads : std::thread::hardware_concurrency()));
+    if (frog_options.master_model == "lagrangian")
+        master_engine.reset(new Lagrangian_Master(net_topo, m_c, *thread_pool));
+    else if (frog_options.master_model == "partitioned")
+        master_engine.reset(new Partitioned_Master(net_topo, m_c, *thread_pool, frog_options.groups));
+    else if (frog_options.master_model == "greedy")
+        master_engine.reset(new Greedy_Master(net_topo, m_c));
+    IloRangeArray master_FeasCutArray(master_results.env);
+    Deadline_Scheduler deadline_scheduler(interval);
     double teta = 2.0; // buffering time. Download duration.
-    unordered_map<string, double> files_sizes(net_topo.requests_qty);
-    get_video_file_sizes(files_sizes);
-    int segment_qty = files_sizes.size() / m_c;
+    auto const segment_wait = std::chrono::milliseconds((long long)(3 * teta * 1000)); // a live video is over after 3 segment durations without a new one
+    if (!fs::exists(frog_options.catalog_file))
+        build_segment_catalog("./mediaServer", frog_options.catalog_file); // first run, --build-catalog rebuilds it
+    Catalog_Watcher catalog_watcher("./mediaServer", frog_options.catalog_file); // new renditions are added while cycles run
+    int video = catalog_watcher.snapshot()->video(frog_options.video);
+    if (video < 0)
+        throw std::runtime_error("video " + frog_options.video + " isn't in segment catalog " + frog_options.catalog_file);
     // phi_c (total number of requested segment by client c) is one of the value which is used in constraint 5 in master
     int phi_c = 0;
     int priority = 0;
@@ -1952,12 +5479,11 @@ void optimizer()
     // cout << "cssw_qty : " << cssw_qty << "\n";
     // cout << "sssw_qty : " << sssw_qty << "\n";
     /*
-    for (int i = 0; i < segment_qty; i++)
+    for (int i = 0; i < catalog_watcher.snapshot()->segment_qty(video); i++)
     {
         for (int j = 0; j < 4; j++)
         {
-            std::string file_name = "BBB-I-1080p.seg" + std::to_string(i) + "-L" + std::to_string(j) + ".svc";
-            cout << file_name << " : " << files_sizes[file_name] << "\n";
+            cout << "segment " << i << " layer " << j << " : " << catalog_watcher.snapshot()->size(video, i, j) << "\n";
         }
     }
     */
@@ -1997,14 +5523,141 @@ void optimizer()
         }
         )";
 
-    // cout << "segment_qty: " << segment_qty << "\n";
-    for (int segment_index = 0; segment_index < segment_qty; segment_index++)
+    std::vector<std::pair<int, Net_Topo::Link_Event>> link_events; // read before the stage threads start, a bad file stops the run here
+    if (!frog_options.link_events_file.empty())
+        link_events = read_link_events(frog_options.link_events_file, net_topo);
+
+    // Cycles run as three stages on their own threads: prepare builds the next segment's demand vectors from the catalog ahead of
+    // its cycle, this thread runs multiserver, master, history update and path packing, publish serializes and sends flow rules
+    // and client messages. Publish of segment k overlaps with prepare and solve of segment k+1. History vectors are only written
+    // by the solve stage before it hands the job over, so segment k+1's master always reads segment k's history. Master's model
+    // update stays on the solve stage, Concert objects of an env aren't safe to touch from two threads.
+    // Inputs and jobs go back to their producer through the spare queues when they're done, so their buffers are reused.
+    Stage_Queue<Segment_Input> prepared(1);
+    Stage_Queue<Publish_Job> publishing(2);
+    Stage_Queue<Segment_Input> spare_inputs(2);
+    Stage_Queue<Publish_Job> spare_jobs(3);
+    Client_Sessions sessions(net_topo.requests_qty);
+    std::thread prepare_thread([&]
+                               {
+        std::vector<Client_Sessions::Session> session_order;
+        for (int segment_index = 0;; segment_index++)
+        {
+            // one snapshot per segment, segments added to the video while it plays are solved too. A segment the catalog doesn't
+            // have yet is waited for over the next catalog updates, the video is over when none brings it within segment_wait.
+            std::shared_ptr<const Segment_Catalog> catalog;
+            auto wait_until = std::chrono::steady_clock::now() + segment_wait;
+            for (;;)
+            {
+                int seen_epoch = catalog_watcher.epoch();
+                catalog = catalog_watcher.snapshot();
+                if (segment_index < catalog->segment_qty(video) || !catalog_watcher.watching() || prepared.is_closed() ||
+                    std::chrono::steady_clock::now() >= wait_until)
+                    break;
+                // short waits, so that stopped stages are seen
+                catalog_watcher.wait_epoch(seen_epoch, std::min(wait_until, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+            }
+            if (segment_index >= catalog->segment_qty(video))
+                break;
+            Segment_Input input;
+            spare_inputs.try_pop(input);
+            input.segment_index = segment_index;
+            for (int c = 0; c < net_topo.requests_qty; c++)
+                sessions.on_request(c, video, segment_index); // client requests aren't served here yet, clients play --video in lockstep
+            // b_bar_cl definitions (file_size/teta vector). Required BW for layer l of client c.
+            input.b_bar_cl.reset(net_topo.requests_qty, m_c, net_topo.client_cssw, cssw_qty);
+            sessions.sorted(session_order);
+            set_b_bar_cl(input.b_bar_cl, session_order, m_c, *catalog, teta); // sets b_bar_cl which contains layers size ( required byte per sec to download in teta time)
+            input.total_w_s_cl_max = total_layer_qty(input.b_bar_cl, net_topo.requests_qty);
+            if (!prepared.push(std::move(input)))
+                break;
+        }
+        prepared.close(); });
+    std::thread publish_thread([&]
+                               {
+        Publish_Job job;
+        while (publishing.pop(job))
+        {
+            auto publish_start_time = std::chrono::steady_clock::now();
+            publish(job, net_topo, json_flows, json_flow_srv_src, json_messages, json_message);
+            auto sent_time = std::chrono::steady_clock::now();
+            flow_assignment_runtimes.emplace_back(job.packing_time + (sent_time - publish_start_time)); // path packing + publish
+            publish_latencies.emplace_back(sent_time - job.cycle_start);
+            job.phase_ms[Metrics_Store::flow_assignment_phase] = flow_assignment_runtimes.back().count() * 1000;
+            job.phase_ms[Metrics_Store::publish_phase] = publish_latencies.back().count() * 1000;
+            metrics_store.finish_segment(job.segment_index, job.phase_ms);
+            deadline_scheduler.record(Deadline_Scheduler::flow_assignment_stage, publish_start_time, job.packing_time);
+            deadline_scheduler.finish_cycle(job.deadline);
+            cout << "segment " << job.segment_index << " published " << std::chrono::duration<double, std::milli>(sent_time - job.cycle_start).count()
+                 << " ms after its cycle start\n";
+            spare_jobs.try_push(std::move(job));
+        } });
+
+    // std::map<int, double> req_max_rates_from_cssws;  // keeps required max data rate for clients site sws
+    std::map<int, double> req_max_rates_from_cssws; // keeps required max data rate for clients site sws
+    std::map<int, std::vector<int>> sorted_r_sc_sol; // int is cssw, vector is sending sssw
+    std::set<int> sending_sssws;                     // keeps all data sending servers
+    std::vector<std::vector<int>> combinations;      // keeps all combinations of sending_sssws of r_value
+    vector<double> provided_rate_for_c(cssw_qty);
+    vector<vector<int>> r_sc_w_s_cl_count(sssw_qty, vector<int>(cssw_qty)); // used to keep number of w send from each r_sc
+    Ring<long long> cycle_allocations(runtime_log_qty); // heap allocations of the last cycles, like the runtime logs
+
+    // --link-events replays a link event file from another thread, like a controller reporting link changes
+    std::mutex replay_mutex;
+    std::condition_variable replay_stop;
+    bool replay_stopped = false;
+    std::thread replay_thread;
+    if (!link_events.empty())
+    {
+        auto replay_start = std::chrono::steady_clock::now();
+        replay_thread = std::thread([&, link_events]
+                                    {
+            for (auto &link_event : link_events)
+            {
+                std::unique_lock<std::mutex> lock(replay_mutex);
+                if (replay_stop.wait_until(lock, replay_start + std::chrono::milliseconds(link_event.first), [&]
+                                           { return replay_stopped; }))
+                    break;
+                net_topo.post_link_event(link_event.second);
+            } });
+    }
+
+    auto stop_stages = [&]
+    {
+        prepared.close();
+        publishing.close();
+        if (prepare_thread.joinable())
+            prepare_thread.join();
+        if (publish_thread.joinable())
+            publish_thread.join();
+        {
+            std::lock_guard<std::mutex> lock(replay_mutex);
+            replay_stopped = true;
+        }
+        replay_stop.notify_all();
+        if (replay_thread.joinable())
+            replay_thread.join();
+    };
+    Stage_Guard stage_guard{stop_stages}; // stages are stopped also when the solve stage throws
+
+    // cout << "segment_qty: " << catalog_watcher.snapshot()->segment_qty(video) << "\n";
+    Segment_Input input;
+    while (prepared.pop(input))
     {
+        int segment_index = input.segment_index;
 
         cout << "\n----------------------------------NEW OPT CYCLE STARTED----------------------------------------------\n";
-        std::this_thread::sleep_until(next);
+        while (net_topo.wait_link_event(next)) // instead of sleep_until(next), the cycle's multiserver solve then starts from the patched LP
+            react_to_link_events(net_topo, multiserver_lp.get(), multiserver_native_engine.get(), input.b_bar_cl, m_c, provided_rate_for_c);
         now = std::chrono::steady_clock::now();
         next = now + std::chrono::milliseconds(interval);
+        long long cycle_start_allocations = heap_allocation_count();
+        Publish_Job job;
+        spare_jobs.try_pop(job);
+        job.segment_index = segment_index;
+        metrics_store.begin_segment(segment_index);
+        job.cycle_start = now;
+        job.deadline = deadline_scheduler.start_cycle(now);
 
         // Calculate the difference
         auto difference = next - now;
@@ -2012,95 +5665,50 @@ void optimizer()
         auto diff_in_ms = std::chrono::duration_cast<std::chrono::milliseconds>(difference).count();
         // cout << "segment " << segment_index << " diff_in_ms: " << diff_in_ms << "\t";
 
-        // b_bar_cl definitions (file_size/teta vector). Required BW for layer l of client c.
-        vector<vector<double>> b_bar_cl(net_topo.requests_qty);                               // size of layers requested by client c
-        set_b_bar_cl(b_bar_cl, net_topo.requests_qty, m_c, files_sizes, teta, segment_index); // sets b_bar_cl which contains layers size ( required byte per sec to download in teta time)
+        Demand_Model &b_bar_cl = input.b_bar_cl; // size of layers requested by client c, prepared ahead
         phi_c++;
 
-        IloEnv masterEnv;
-        IloEnv multiserverEnv;
-        IloIntVarArray3 w_s_cl(masterEnv, net_topo.requests_qty);  // whether server s serves layer l to client c
-        IloNumArray3 w_s_cl_sol(masterEnv, net_topo.requests_qty); // result of optimization of w_s_cl
-        for (int i = 0; i < net_topo.requests_qty; i++)            // Initilization of w_s_cl
-        {
-            int layer_qty = m_c;
-            w_s_cl_sol[i] = IloNumArray2(masterEnv, layer_qty);
-            for (int j = 0; j < layer_qty; j++)
-            {
-                w_s_cl_sol[i][j] = IloNumArray(masterEnv, net_topo.srv_qty);
-            }
-        }
-
-        IloIntArray v_c_sol(masterEnv, net_topo.requests_qty); // stores v_c result to use it in v_bar_c for next optimizations.
+        IloNumArray3 &w_s_cl_sol = master_results.w_s_cl_sol; // master results are kept across cycles
+        IloIntArray &v_c_sol = master_results.v_c_sol;
 
         // IloBool solution_found = IloFalse;
         IloBool solution_found = IloTrue;
-        int total_w_s_cl_max = total_layer_qty(b_bar_cl, net_topo.requests_qty);
+        int total_w_s_cl_max = input.total_w_s_cl_max;
 
         int total_w_s_cl_ub = total_w_s_cl_max;
         int last_feas_total_w_s_cl = 0;
         int last_infeas_total_w_s_cl = total_w_s_cl_max;
 
-        IloNumVar Q(masterEnv, 0, 1);
-        IloNumVar L(masterEnv, 0, 1);
-        IloNumVarArray T_c(masterEnv, net_topo.requests_qty, 0, 1);
-        IloNumVarArray I_c(masterEnv, net_topo.requests_qty, 0, 1);
-        IloIntVarArray v_c(masterEnv, net_topo.requests_qty, 0, 1);
-        IloNumVarArray N_c(masterEnv, net_topo.requests_qty, 0, 1);
-
-        IloExpr masterOptConstExpr(masterEnv);
-
-        IloArray<IloRangeArray> masterConst1_RangeArr(masterEnv, net_topo.requests_qty);
-        IloArray<IloArray<IloRangeArray>> masterConst2_RangeArr(masterEnv, net_topo.requests_qty);
-        IloArray<IloRangeArray> masterConst3_RangeArr(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst4_RangeArr1(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst4_RangeArr2(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst5_RangeArr(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst6_RangeArr(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst7_RangeArr1(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst7_RangeArr2(masterEnv, net_topo.requests_qty);
-        IloRangeArray masterConst8_RangeArr(masterEnv, net_topo.requests_qty);
-        IloRangeArray master_FeasCutArray(masterEnv);
-        IloNumArray2 r_sc_sol(multiserverEnv, sssw_qty);
-        IloNumArray2 r_sc_gamma_sol(multiserverEnv, sssw_qty);
-        IloNumArray4 f_sc_ij_sol(multiserverEnv, sssw_qty);
-
-        IloNumArray2 gamma_ij_sol(multiserverEnv, (net_topo.srv_qty + net_topo.sw_qty));
-        // std::map<int, double> req_max_rates_from_cssws;  // keeps required max data rate for clients site sws
-        std::map<int, double> req_max_rates_from_cssws; // keeps required max data rate for clients site sws
-
-        std::map<int, std::vector<int>> sorted_r_sc_sol; // int is cssw, vector is sending sssw
-        std::set<int> sending_sssws;                     // keeps all data sending servers
-        std::vector<std::vector<int>> combinations;      // keeps all combinations of sending_sssws of r_value
+        IloNumArray2 &r_sc_sol = multiserver_results.r_sc_sol; // multiserver results are kept across cycles
+        IloNumArray2 &r_sc_gamma_sol = multiserver_results.r_sc_gamma_sol;
+        IloNumArray4 &f_sc_ij_sol = multiserver_results.f_sc_ij_sol;
+        IloNumArray2 &gamma_ij_sol = multiserver_results.gamma_ij_sol;
+        // per cycle buffers are declared before the loop and emptied here, rows keep their capacity
+        req_max_rates_from_cssws.clear();
+        for (int y = 0; y < cssw_qty; y++)
+            req_max_rates_from_cssws[y + net_topo.srv_qty + net_topo.OF_SWs.size()] = b_bar_cl.cssw_rate(y); // kept by the demand model
+        sorted_r_sc_sol.clear();
+        sending_sssws.clear();
+        combinations.clear();
         int r_value = 1;
         int nCr_counter = 0;
         int addition_to_sub_layer = 0;
         bool need_inc_add_sub_layer = false;
         int inc_cancelled = 0;
-        vector<double> provided_rate_for_c(cssw_qty);
-
-        for (int s = 0; s < sssw_qty; s++)
-        {
-            r_sc_sol[s] = IloNumArray(multiserverEnv, cssw_qty);
-            r_sc_gamma_sol[s] = IloNumArray(multiserverEnv, cssw_qty);
-        }
-
-        for (int i = net_topo.srv_qty; i < (net_topo.srv_qty + net_topo.sw_qty); i++)
-        {
-            gamma_ij_sol[i] = IloNumArray(multiserverEnv, (net_topo.srv_qty + net_topo.sw_qty));
-        }
-
-        int a_s_cl = 1;
+        std::fill(provided_rate_for_c.begin(), provided_rate_for_c.end(), 0.0);
 
         auto opt_start_time = std::chrono::steady_clock::now();
         // multiserver(multiserverEnv, net_topo, b_bar_cl, net_topo.requests_qty, r_sc_sol, r_sc_gamma_sol, req_max_rates_from_cssws, gamma_ij_sol, provided_rate_for_c);
         //cout << "multiserver starts\n";
-        multiserver(multiserverEnv, net_topo, b_bar_cl, m_c, r_sc_sol, r_sc_gamma_sol, gamma_ij_sol, provided_rate_for_c, f_sc_ij_sol);
+        if (multiserver_lp)
+            multiserver(*multiserver_lp, net_topo, b_bar_cl, m_c, provided_rate_for_c);
+        else
+            multiserver_native(*multiserver_native_engine, net_topo, provided_rate_for_c);
         //cout << "multiserver ends\n";
+        deadline_scheduler.record(Deadline_Scheduler::multiserver_stage, opt_start_time);
+        auto master_start_time = std::chrono::steady_clock::now();
+        master_results.solve_deadline = deadline_scheduler.master_deadline();
 
-        masterInitBuilder(masterEnv, w_s_cl, Q, L, T_c, I_c, v_c, N_c, net_topo.requests_qty, b_bar_cl, net_topo, m_c, a_s_cl, masterOptConstExpr, masterConst1_RangeArr, masterConst2_RangeArr,
-                          masterConst3_RangeArr, masterConst4_RangeArr1, masterConst4_RangeArr2, masterConst5_RangeArr, masterConst6_RangeArr, masterConst7_RangeArr1, masterConst7_RangeArr2,
-                          masterConst8_RangeArr, phi_c);
         bool worst_case = false;
         bool master_solved = false;
         int counter = 0;
@@ -2108,270 +5716,170 @@ void optimizer()
         int total_w_s_cl_result = 0;
         int total_w_s_cl_sol = 0;
 
-        vector<vector<int>> r_sc_w_s_cl_count(net_topo.ServerSideOFSWs.size(), vector<int>(net_topo.ClientSideOFSWs.size())); // used to keep number of w send from each r_sc
+        for (auto &count : r_sc_w_s_cl_count)
+            std::fill(count.begin(), count.end(), 0);
 
-        if (!worst_case)
+        if (master_engine)
+        {
+            master_greedy(master_results, *master_engine, net_topo.requests_qty, b_bar_cl, net_topo, m_c, r_sc_sol, counter, r_sc_w_s_cl_count, sorted_r_sc_sol,
+                          sending_sssws, total_w_s_cl_result, master_solved, segment_index);
+        }
+        else if (!master_milp)
+        {
+            master_aggregated(master_results, net_topo.requests_qty, b_bar_cl, net_topo, m_c, r_sc_sol, counter, r_sc_w_s_cl_count, sorted_r_sc_sol,
+                              sending_sssws, total_w_s_cl_result, master_solved, segment_index);
+        }
+        else if (!worst_case)
         {
-            master(masterEnv, w_s_cl, w_s_cl_sol, Q, L, T_c, I_c, v_c, v_c_sol, N_c, net_topo.requests_qty, b_bar_cl, net_topo, m_c, a_s_cl, masterOptConstExpr, masterConst1_RangeArr, masterConst2_RangeArr,
-                   masterConst3_RangeArr, masterConst4_RangeArr1, masterConst4_RangeArr2, masterConst5_RangeArr, masterConst6_RangeArr, masterConst7_RangeArr1, masterConst7_RangeArr2, masterConst8_RangeArr, total_w_s_cl_ub, total_w_s_cl_max,
+            master(*master_milp, net_topo.requests_qty, b_bar_cl, net_topo, m_c, phi_c, total_w_s_cl_ub, total_w_s_cl_max,
                    r_sc_sol, r_sc_gamma_sol, counter, req_max_rates_from_cssws, gamma_ij_sol, r_sc_w_s_cl_count, master_FeasCutArray, sorted_r_sc_sol,
                    sending_sssws, combinations, nCr_counter, r_value, addition_to_sub_layer, need_inc_add_sub_layer, inc_cancelled, provided_rate_for_c, dec_buff_for_master, total_w_s_cl_result,
                    master_solved, last_infeas_total_w_s_cl, total_w_s_cl_sol, segment_index);
         }
+        deadline_scheduler.record(Deadline_Scheduler::master_stage, master_start_time);
+        job.phase_ms[Metrics_Store::multiserver_phase] = std::chrono::duration<double, std::milli>(master_start_time - opt_start_time).count();
+        job.phase_ms[Metrics_Store::master_phase] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - master_start_time).count();
+        job.phase_ms[Metrics_Store::master_nodes_phase] = master_milp && master_solved && !master_nodes.empty() ? master_nodes.back() : 0;
 
 
         auto flow_assignment_start_time = std::chrono::steady_clock::now();
         //cout << "Flow assignment starts\n";
+        job.solution_found = solution_found;
+        job.priority = ++priority;
+        job.m_c = m_c;
+        job.flow_rules.clear();
+        job.quality.assign(net_topo.requests_qty, 0);
+        job.layer_servers.assign(net_topo.requests_qty * m_c, -1);
         if (solution_found)
         {
-
-            // reader.parse(text_message, json_message);
-            // reader.parse(text_messages, json_messages);
-
-            std::vector<int> w_result_i(net_topo.requests_qty);
-            std::vector<int> w_result_k(net_topo.srv_qty);
-            for (int k = 0; k < net_topo.srv_qty; k++)
-            {
-                for (int i = 0; i < net_topo.requests_qty; i++)
-                {
-                    int w_result_for_k = 0;
-                    int layer_qty = m_c;
-                    for (int j = 0; j < layer_qty; j++)
-                    {
-                        w_result_i[i] += w_s_cl_sol[i][j][k]; // i=client, j=layer, k=server
-                        w_result_for_k += w_s_cl_sol[i][j][k];
-                    }
-                    // cout << "client " << requests[i]->get_endpoint().address().to_string() << "'s w result in SOLUTION FOUND from server "<< k << ": " << w_result_i[i] << "\n";
-                    w_result_k[k] += w_result_for_k;
-                }
-                // cout << " w results in SOLUTION FOUND from server " << k << ": " << w_result_k[k] << "\n";
-            }
-            std::vector<std::vector<int>> usage_in_flows(net_topo.srv_qty + net_topo.sw_qty, std::vector<int>(net_topo.srv_qty + net_topo.sw_qty, 0));
-            json_flow_srv_src["priority"] = ++priority;
-            int flow_counter = 0;
-            json_flows.clear();
-            json_messages.clear();
+            std::vector<int> usage_in_flows(net_topo.edge_qty(), 0); // assigned layer rates on each CSR edge
+            int unassigned_layers = 0;
+            if (multiserver_path_lp)
+                path_table.assign(multiserver_path_lp->candidates, multiserver_path_lp->path_rate_sol);
+            else
+                path_table.build(net_topo, f_sc_ij_sol);
             //cout << "flow assignment start\n";
             // Flow assingments, starting from least available capacity owner switch.
-            for (auto c_s : sorted_r_sc_sol)
+            for (auto &c_s : sorted_r_sc_sol)
             {
                 for (int s_sssw : c_s.second)
                 {
-                    int s_cssw = c_s.first;                                     // in Y
-                    int y = s_cssw + net_topo.srv_qty + net_topo.OF_SWs.size(); // e index of client site switch
-                    int x = s_sssw + net_topo.srv_qty;                          ////e index of server site switch
-                    auto sssw_itr = net_topo.ServerSideOFSWs_Connected_Servers.find(s_sssw + net_topo.srv_qty);
-                    std::string srv_ip = net_topo.srv_e_index_ip[s_sssw];
+                    int s_cssw = c_s.first; // in Y
 
                     // if there is some data to send from this sssw to cssw
                     if (r_sc_sol[s_sssw][s_cssw] > 0)
                     {
+                        // layers served from this sssw to clients attached to this cssw, packed onto the commodity's paths
+                        std::vector<std::pair<int, int>> client_layers;
                         int layer_qty = m_c;
-                        double total_fixed_r_sc = 0;
                         for (int l = 0; l < layer_qty; l++)
                         {
-                            for (int c = 0; c < net_topo.requests_qty; c++)
+                            for (int c : net_topo.client_attachments[s_cssw].clients)
                             {
                                 if (w_s_cl_sol[c][l][s_sssw] == 1)
-                                {
-                                    // cout << "layer: " << l << " - client: " << c << "\n";
-                                    // json_flow_srv_dst["selector"]["criteria"][4]["type"] = "TCP_DST";
-                                    // json_flow_srv_dst["selector"]["criteria"][4]["tcpPort"] = TCP_PORTS[port_change_flag][layer]; // port_change_flag variable fixed as 0. Bacause I deciced to use only one TCP port set on server side as consequence of deciding that clients send sequential http requests to servers.
-                                    json_flow_srv_src["selector"]["criteria"][4]["type"] = "TCP_SRC";
-                                    json_flow_srv_src["selector"]["criteria"][4]["tcpPort"] = 8000 + l;
-
-                                    std::string client_ip = "10." + std::string("1.") + std::to_string(c / 256) + "." + std::to_string(c % 256);
-
-                                    int current_sw = x;
-                                    int sw_counter = 0;
-                                    while (current_sw != y)
-                                    {
-                                        // cout << "current_sw("<<current_sw<<") --- " <<"y("<<y<<")\n";
-                                        //  cout << "current_sw != y: " << current_sw <<   " != " << y << "\n";
-
-                                        for (int next_sw : net_topo.OF_SWs_Connections[current_sw])
-                                        {
-                                            // cout << "next_sw: " <<next_sw <<"\n";
-                                            double buffer_priority = 1.0;
-                                            if (f_sc_ij_sol[s_sssw][s_cssw][current_sw][next_sw] - buffer_priority * b_bar_cl[c][l] >= 0.0)
-                                            {
-                                                // cout << "f_sc_ij_sol["<<s_sssw<<"]["<<s_cssw<<"]["<<current_sw<<"]["<< next_sw<<"]: "<< f_sc_ij_sol[s_sssw][s_cssw][current_sw][next_sw] <<"\n";
-                                                //  cout << "current_sw - next_sw: " << current_sw << " - " << next_sw << "\n";
-                                                f_sc_ij_sol[s_sssw][s_cssw][current_sw][next_sw] -= buffer_priority * b_bar_cl[c][l];
-
-                                                usage_in_flows[current_sw][next_sw] += buffer_priority * b_bar_cl[c][l];
-
-                                                // net_topo.total_b_bar_cl_at_t_1_on_ij[current_sw][next_sw] = usage_in_flows[current_sw][next_sw];
-
-                                                json_flow_srv_src["deviceId"] = "of:"; //+ net_topo.sw_e_index_id.find(current_sw)->second;         // DeviceId is added to flow text
-                                                // cout << "f_sc_ij_sol["<<s_sssw<<"]["<<s_cssw<<"]["<<current_sw<<"]["<< next_sw<<"]: "<< f_sc_ij_sol[s_sssw][s_cssw][current_sw][next_sw] <<"\n";
+                                    client_layers.emplace_back(c, l);
+                            }
+                        }
+                        std::stable_sort(client_layers.begin(), client_layers.end(), [&](const std::pair<int, int> &a, const std::pair<int, int> &b)
+                                         { return b_bar_cl[a.first][a.second] > b_bar_cl[b.first][b.second]; }); // first fit decreasing
 
-                                                json_flow_srv_src["treatment"]["instructions"][0]["port"] = "1";        // net_topo.ports[current_sw][next_sw]; // output port added
-                                                json_flow_srv_src["selector"]["criteria"][1]["ip"] = srv_ip + "/32";    // IPV4_SRC - Server IP
-                                                json_flow_srv_src["selector"]["criteria"][2]["ip"] = client_ip + "/32"; // IPV4_DST - Client IP
-                                                json_flows["flows"][flow_counter++] = json_flow_srv_src;
-                                                current_sw = next_sw;
-                                                break;
-                                            }
-                                        }
-                                        if (++sw_counter >= net_topo.sw_qty)
-                                            break;
-                                    }
-                                }
+                        for (auto &client_layer : client_layers)
+                        {
+                            int c = client_layer.first;
+                            int l = client_layer.second;
+                            double buffer_priority = 1.0;
+                            int p = path_table.first_fit(s_sssw, s_cssw, buffer_priority * b_bar_cl[c][l]);
+                            if (p < 0)
+                            {
+                                unassigned_layers++;
+                                continue;
+                            }
+                            auto path = path_table.edges(p);
+                            for (int k : path)
+                            {
+                                usage_in_flows[k] += buffer_priority * b_bar_cl[c][l];
+                                // net_topo.total_b_bar_cl_at_t_1_on_ij[current_sw][next_sw] = usage_in_flows[k];
                             }
+                            job.flow_rules.push_back(Flow_Rule{c, l, s_sssw, path.size()});
                         }
                     }
                 } // End of for(int sssw : c_s.second) --- to traverse all s for each c
             } // End of for(c_s : sorted_r_sc_sol) --- to traverse all c
+            if (unassigned_layers > 0)
+                cout << unassigned_layers << " layers didn't fit any path of their sssw-cssw flow\n";
             //cout << "flow assignment end\n";
 
-            Json::FastWriter fastWriter;
-            std::string flows = fastWriter.write(json_flows);
-            // net_topo.add_flow(flows);
-
-            //cout << "json messages - start\n";
             for (int i = 0; i < net_topo.requests_qty; ++i)
             {
-                std::string client_ip = "10." + std::string("1.") + std::to_string(i / 256) + "." + std::to_string(i % 256);
-
-                // string client_ip = requests[i]->get_endpoint().address().to_string(); // Client IP
                 int w_s_c_l_sol_for_i = 0; // result of optimization of layer quality for c's requested segment
                 int layer_qty = m_c;
-                // layer_qty = b_bar_cl[i].size();
                 for (int j = 0; j < layer_qty; ++j)
                 {
-                    // w_s_c_l_sol_for_i += IloSum(w_s_cl_sol[i][j]);
-
                     for (int k = 0; k < net_topo.srv_qty; k++)
                     {
                         w_s_c_l_sol_for_i += w_s_cl_sol[i][j][k];
                     }
                 }
 
-                json_messages.clear();
-
                 mu_bar_c[i] += abs(w_s_c_l_sol_for_i - l_bar_c[i]); // used in contraint 6 in master - layer switch intensity
                 v_bar_c[i] += v_c_sol[i];                           // used in contraint 7 in master - layer switch
                 l_bar_c[i] = w_s_c_l_sol_for_i;                     // used in contraint 6 in master. Previous time slot achived layers. This var will be used in next opt calculation
                 lambda_bar_c[i] += w_s_c_l_sol_for_i;               // used in contraint 5 in master
+                job.quality[i] = w_s_c_l_sol_for_i;
 
                 for (int layer = 0; layer < w_s_c_l_sol_for_i; ++layer)
                 {
-                    json_message["layer"] = layer; // message to client for layer info
-                    json_message["tcp_port"] = (8000 + layer);
-
-                    int current_sw_index;
-                    string srv_ip;
-                    for (int s = 0; s < net_topo.srv_qty; s++)// traverse all servers
-                    {                                     
-                        if (w_s_cl_sol[i][layer][s] == 1) 
-                        {
-                            srv_ip = net_topo.srv_e_index_ip[s];
-                            // cout << "srv_ip: " << srv_ip << "\n";
-                            json_message["server_ip"] = srv_ip; // message prepperation to client
-                        }
-                    }
-                    json_messages["msgs"][layer] = json_message;
-                }
-
-                // json_messages["indx"] = requests[i]->get_seg_index();
-                json_messages["indx"] = segment_index;
-                json_messages["buf"] = 0;
-                json_messages["ip"] = client_ip;
-
-                if (w_s_c_l_sol_for_i == 0)
-                {
-                    string srv_ip;
-                    if (srv_ip == "")
+                    int layer_server = -1;
+                    for (int s = 0; s < net_topo.srv_qty; s++) // traverse all servers
                     {
-                        auto itr = net_topo.servers.begin();
-                        std::advance(itr, (i % net_topo.servers.size()));
-
-                        // string ip = *itr;
-                        srv_ip = *itr;
-                        // cout << "server ip: " << srv_ip << "\n";
+                        if (w_s_cl_sol[i][layer][s] == 1)
+                            layer_server = s;
                     }
-                    json_message["layer"] = 0; // message to client for layer info
-                    json_message["layer_qty"] = 1;
-                    json_message["tcp_port"] = 8000;
-                    json_message["server_ip"] = srv_ip; // preferred or previous iteration server ip
-
-                    json_messages["msgs"][0] = json_message;
-                    // cout << "sol is 0 - json_message: " << json_message << "\n";
-                    json_messages["indx"] = segment_index;
-                    json_messages["buf"] = 0;
-                    json_messages["ip"] = client_ip;
+                    job.layer_servers[i * m_c + layer] = layer_server;
                 }
-
-                Json::FastWriter fastWriter;
-                std::string messages = fastWriter.write(json_messages); // json to string conversion - message to client{"layer_qty":int, "tcp_port":int}
-            } // end of for of requests
-            //cout << "json messages - end\n";
-
-            // delete_requests(net_topo.requests_qty); // deletes requests elements till net_topo.requests_qty
+            }
         }
         else
         {
-            // BU ALANA CLIENT İÇİN DÖNÜŞ BİLGİSİ KODLAMASI YAPILACAK.
-            cout << "NO SOLUTION AVAIABLE! --- SENDING BASE LAYER INFO\n";
-            cout << "net_topo.srv_qty: " << net_topo.srv_qty << "\n";
-
             for (int i = 0; i < net_topo.requests_qty; ++i)
             {
-                // message preperation to client
-                json_messages.clear();
-                std::string client_ip = "10." + std::string("1.") + std::to_string(i / 256) + "." + std::to_string(i % 256);
-
-                // string client_ip = requests[i]->get_endpoint().address().to_string(); // Client IP
-
                 mu_bar_c[i] += abs(1 - l_bar_c[i]); // used in contraint 6 in master - layer switch intensity
                 v_bar_c[i] += v_c_sol[i];           // used in contraint 7 in master - layer switch
                 l_bar_c[i] = 1;
                 lambda_bar_c[i] += 1;
-
-                // std::string srv_ip = requests[i]->get_srv_ip();
-                std::string srv_ip = "10.0.0.200";
-
-                if (srv_ip == "")
-                {
-                    auto itr = net_topo.servers.begin();
-                    std::advance(itr, (i % net_topo.servers.size()));
-                    srv_ip = *itr;
-                }
-                json_message["layer"] = 0; // message to client for layer info
-                json_message["tcp_port"] = 8000;
-                json_message["server_ip"] = srv_ip; // preferred or previous iteration server ip
-
-                json_messages["msgs"][0] = json_message;
-                json_messages["indx"] = segment_index;
-                json_messages["buf"] = 0;
-                json_messages["ip"] = client_ip;
-                Json::FastWriter fastWriter;
-                std::string message = fastWriter.write(json_messages); // json to string conversion - message to client{"layer_qty":int, "tcp_port":int}
-                // cout << "requests[" << i << "] message: " << message << " sent!!!\n";
-                // requests[i]->post(message);
-                // cout << client_ip << " - message sent: " << message << "\n";
-            } // end of for of requests
-            // delete_requests(requests_qty); // deletes requests elements till requests_qty
+            }
         }
-        flow_assignment_runtimes.emplace_back((std::chrono::steady_clock::now() - flow_assignment_start_time)); // Optimizer's run time is recorded.
-
-        multiserverEnv.end();
-        masterEnv.end();
-        optimizer_runtimes.emplace_back((std::chrono::steady_clock::now() - opt_start_time)); // Optimizer's run time is recorded.
+        job.packing_time = std::chrono::steady_clock::now() - flow_assignment_start_time;
+        optimizer_runtimes.emplace_back((std::chrono::steady_clock::now() - opt_start_time)); // Optimizer's run time is recorded. Publish is in publish_latencies.
+        job.phase_ms[Metrics_Store::cycle_phase] = optimizer_runtimes.back().count() * 1000;
+        if (cycle_start_allocations >= 0)
+            cycle_allocations.emplace_back(heap_allocation_count() - cycle_start_allocations);
+        publishing.push(std::move(job));
+        spare_inputs.try_push(std::move(input));
 
     } // End of segment_index loop
-    cout << "Video Quality:\n";
-    for (int i = 0; i < net_topo.requests_qty; i++)
+    stop_stages(); // publish of the last segment is waited
+
+    if (!cycle_allocations.empty())
     {
-        for (auto quality : video_quality[i])
+        cout << "Heap Allocations per Cycle (cycle start to publish hand-off, all threads):";
+        for (auto allocations : cycle_allocations)
         {
-            cout << quality << "\t";
+            cout << allocations << "\t";
         }
         cout << "\n";
+        cout << "\n";
+    }
+
+    cout << "Segment Publish Latencies:"; // cycle start to last message sent
+    for (auto latency : publish_latencies)
+    {
+        cout << latency.count() << "\t";
     }
     cout << "\n";
     cout << "\n";
+
+    print_metrics(metrics_store);
     cout << "Optimizer Runtimes:";
     for (auto runtime : optimizer_runtimes)
     {
@@ -2387,13 +5895,757 @@ void optimizer()
         cout << runtime.count() << "\t";
     }
     cout << "\n";
+    cout << "\n";
+
+    cout << "Multiserver Runtimes:";
+    for (auto runtime : multiserver_runtimes)
+    {
+        cout << runtime.count() << "\t";
+    }
+    cout << "\n";
+
+    if (!link_event_reactions.empty())
+    {
+        cout << "Link Event Reactions:"; // event posted to multiserver re-solved
+        for (auto reaction : link_event_reactions)
+        {
+            cout << reaction.count() << "\t";
+        }
+        cout << "\n";
+    }
+
+    if (!master_solve_runtimes.empty())
+    {
+        cout << "\n";
+        cout << "Master Solve Runtimes (" << frog_options.switch_model << " switches):";
+        for (auto runtime : master_solve_runtimes)
+        {
+            cout << runtime.count() << "\t";
+        }
+        cout << "\n";
+        cout << "Master Nodes:";
+        for (auto nodes : master_nodes)
+        {
+            cout << nodes << "\t";
+        }
+        cout << "\n";
+    }
 
 } // End of optimizer()
 
+// Compares memory and startup time of the CSR core graph + client attachment tables against the former dense vertex_qty x vertex_qty matrices (e, link_capacity, b_ij).
+// Dense matrices above 2 GB are not allocated, their footprint is reported from vertex_qty.
+void bench_topology_store()
+{
+    for (int requests : {5000, 20000, 50000})
+    {
+        auto csr_start = std::chrono::steady_clock::now();
+        Net_Topo net_topo(requests, frog_options.topology_file);
+        std::chrono::duration<double> csr_time = std::chrono::steady_clock::now() - csr_start;
+
+        long long vertex_qty = net_topo.vertex_qty;
+        long long dense_bytes = 3 * vertex_qty * vertex_qty * (long long)sizeof(int);
+        std::chrono::duration<double> dense_time(0);
+        bool dense_allocated = dense_bytes <= 2LL * 1024 * 1024 * 1024;
+        if (dense_allocated)
+        {
+            auto dense_start = std::chrono::steady_clock::now();
+            vector<vector<int>> e(vertex_qty, vector<int>(vertex_qty, 0));
+            vector<vector<int>> link_capacity(vertex_qty, vector<int>(vertex_qty, 0));
+            vector<vector<int>> b_ij(vertex_qty, vector<int>(vertex_qty, 0));
+            for (int i = 0; i < net_topo.core_qty; i++)
+            {
+                for (int j : net_topo.neighbours(i))
+                {
+                    e[i][j] = 1;
+                    link_capacity[i][j] = net_topo.capacity(i, j);
+                }
+            }
+            for (int i = net_topo.core_qty; i < vertex_qty; i++)
+            {
+                for (int j : net_topo.ClientSideOFSWs)
+                {
+                    e[i][j] = e[j][i] = 1;
+                    link_capacity[i][j] = link_capacity[j][i] = net_topo.client_attachments[0].access_capacity[0];
+                }
+            }
+            for (int i = 0; i < vertex_qty; i++)
+            {
+                for (int j = 0; j < vertex_qty; j++)
+                {
+                    b_ij[i][j] = link_capacity[i][j];
+                }
+            }
+            dense_time = std::chrono::steady_clock::now() - dense_start;
+        }
+
+        cout << "clients: " << requests << "\tvertices: " << vertex_qty << "\tcore edges: " << net_topo.edge_qty() << "\n";
+        cout << "  dense  : " << dense_bytes / (1024.0 * 1024.0) << " MB\t";
+        if (dense_allocated)
+            cout << dense_time.count() << " s\n";
+        else
+            cout << "not allocated\n";
+        cout << "  csr    : " << net_topo.topology_bytes() / (1024.0 * 1024.0) << " MB (core graph " << net_topo.core_bytes() << " bytes)\t" << csr_time.count() << " s (whole Net_Topo construction)\n";
+    }
+}
+
+// --bench-paths: size and solve time of the arc and path formulations of the multiserver LP on generated topologies of 50 to 500
+// sws. Each has n/25 sssws with a server, n/10 cssws, and transit sws on a ring with random chords. Each sssw and cssw is linked
+// to two transit sws. The arc LP is built while it has at most 2M f_sc_ij variables, above that its size is counted as its build() would make it.
+void bench_path_formulation()
+{
+    std::mt19937 rng(25);
+    std::string topology_path = (fs::temp_directory_path() / "frog_bench_paths.topo").string();
+    std::array<int, 3> capacities = {1000, 2500, 10000};
+    for (int sw_qty : {50, 100, 200, 500})
+    {
+        int sssw_qty = std::max(2, sw_qty / 25);
+        int cssw_qty = std::max(4, sw_qty / 10);
+        int transit_qty = sw_qty - sssw_qty - cssw_qty;
+        {
+            std::ofstream topo(topology_path, std::ios::trunc);
+            std::uniform_int_distribution<int> transit(0, transit_qty - 1);
+            std::uniform_int_distribution<int> capacity(0, capacities.size() - 1);
+            std::set<std::pair<std::string, std::string>> links;
+            auto link = [&](const std::string &a, const std::string &b)
+            {
+                if (a != b && !links.count({b, a}) && links.insert({a, b}).second)
+                    topo << "link " << a << " " << b << " " << capacities[capacity(rng)] << "\n";
+            };
+            for (int s = 0; s < sssw_qty; s++)
+                topo << "server srv" << s << " 10.0.1." << s << "\nswitch x" << s << " server_side\nlink srv" << s << " x" << s << " 10000\n";
+            for (int c = 0; c < cssw_qty; c++)
+                topo << "switch y" << c << " client_side\n";
+            for (int t = 0; t < transit_qty; t++)
+                topo << "switch t" << t << "\n";
+            for (int t = 0; t < transit_qty; t++)
+            {
+                link("t" + std::to_string(t), "t" + std::to_string((t + 1) % transit_qty));
+                link("t" + std::to_string(t), "t" + std::to_string(transit(rng)));
+            }
+            for (int s = 0; s < sssw_qty; s++)
+                for (int l = 0; l < 2; l++)
+                    link("x" + std::to_string(s), "t" + std::to_string(transit(rng)));
+            for (int c = 0; c < cssw_qty; c++)
+                for (int l = 0; l < 2; l++)
+                    link("y" + std::to_string(c), "t" + std::to_string(transit(rng)));
+        }
+        Net_Topo net_topo(100, topology_path);
+
+        long long e_qty = net_topo.core_qty;
+        long long commodity_qty = sssw_qty * cssw_qty;
+        long long sw_edges = 0;
+        for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+            for (int j : net_topo.neighbours(i))
+                sw_edges += j >= net_topo.srv_qty;
+        long long arc_cols = commodity_qty * e_qty * e_qty + commodity_qty + e_qty * e_qty;
+        long long arc_rows = sssw_qty + commodity_qty * (1 + net_topo.OF_SWs_No_SSSWs.size()) + sw_edges;
+        long long arc_nnzs = 0;
+        double arc_obj = 0;
+        std::chrono::duration<double, std::milli> arc_build(0), arc_solve(0);
+        bool arc_built = commodity_qty * e_qty * e_qty <= 2000000;
+        if (arc_built)
+        {
+            Multiserver_LP arc_lp(net_topo);
+            auto solve_start = std::chrono::steady_clock::now();
+            arc_lp.solve();
+            arc_solve = std::chrono::steady_clock::now() - solve_start;
+            arc_build = arc_lp.build_time;
+            arc_obj = arc_lp.multiserverCplex.getObjValue();
+            arc_cols = arc_lp.multiserverCplex.getNcols();
+            arc_rows = arc_lp.multiserverCplex.getNrows();
+            arc_nnzs = arc_lp.multiserverCplex.getNNZs();
+        }
+        Multiserver_Path_LP path_lp(net_topo, frog_options.k_paths);
+        auto solve_start = std::chrono::steady_clock::now();
+        path_lp.solve();
+        std::chrono::duration<double, std::milli> path_solve = std::chrono::steady_clock::now() - solve_start;
+        double path_obj = path_lp.multiserverCplex.getObjValue();
+
+        cout << "sws: " << sw_qty << "\tsssws: " << sssw_qty << "\tcssws: " << cssw_qty << "\tsw edges: " << sw_edges << "\n";
+        cout << "  arc  LP: " << arc_cols << " cols, " << arc_rows << " rows";
+        if (arc_built)
+            cout << ", " << arc_nnzs << " nnzs, built in " << arc_build.count() << " ms, solved in " << arc_solve.count() << " ms, objective " << arc_obj << "\n";
+        else
+            cout << ", not built\n";
+        cout << "  path LP: " << path_lp.multiserverCplex.getNcols() << " cols, " << path_lp.multiserverCplex.getNrows() << " rows, " << path_lp.multiserverCplex.getNNZs()
+             << " nnzs, " << path_lp.candidates.path_qty() << " paths, built in " << path_lp.build_time.count() << " ms, solved in " << path_solve.count()
+             << " ms, objective " << path_obj << "\n";
+    }
+    fs::remove(topology_path);
+}
+
+// --bench-link-events: fails and restores each sw to sw link of the topology from another thread and times the event path,
+// event posted to patched and re-solved multiserver stage (--lp-solver selects the engine)
+void bench_link_events()
+{
+    Net_Topo net_topo(100, frog_options.topology_file);
+    std::unique_ptr<Multiserver_Live_LP> multiserver_lp;
+    std::unique_ptr<Multiserver_Native> multiserver_native_engine;
+    if (frog_options.lp_solver == "native")
+        multiserver_native_engine.reset(new Multiserver_Native(net_topo));
+    else if (frog_options.lp_solver == "paths")
+        multiserver_lp.reset(new Multiserver_Path_LP(net_topo, frog_options.k_paths));
+    else
+        multiserver_lp.reset(new Multiserver_LP(net_topo));
+    int const m_c = 4;
+    Demand_Model b_bar_cl;
+    vector<double> provided_rate_for_c(net_topo.ClientSideOFSWs.size());
+    if (multiserver_lp)
+        multiserver(*multiserver_lp, net_topo, b_bar_cl, m_c, provided_rate_for_c); // first solve, later ones start from its basis
+    else
+        multiserver_native(*multiserver_native_engine, net_topo, provided_rate_for_c);
+    link_event_reactions.clear();
+
+    int links = 0;
+    for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+    {
+        for (int j : net_topo.neighbours(i))
+        {
+            if (j <= i)
+                continue; // each link once, both directions change together
+            links++;
+            for (auto kind : {Net_Topo::Link_Event::failure, Net_Topo::Link_Event::restoration})
+            {
+                std::thread controller([&net_topo, kind, i, j]
+                                       { net_topo.post_link_event({kind, i, j, 0, {}}); });
+                while (!net_topo.wait_link_event(std::chrono::steady_clock::now() + std::chrono::seconds(1)))
+                    ;
+                react_to_link_events(net_topo, multiserver_lp.get(), multiserver_native_engine.get(), b_bar_cl, m_c, provided_rate_for_c);
+                controller.join();
+            }
+        }
+    }
+
+    double total = 0, worst = 0;
+    for (auto reaction : link_event_reactions)
+    {
+        total += reaction.count() * 1000;
+        worst = std::max(worst, reaction.count() * 1000);
+    }
+    cout << "link events: " << links << " links failed and restored, " << link_event_reactions.size() << " reactions with " << frog_options.lp_solver
+         << ", event to re-solved mean " << total / std::max<size_t>(1, link_event_reactions.size()) << " ms, max " << worst << " ms\n";
+}
+
+// LP objective of a multiserver solution, -10 per unit of r_sc, 1 per unit of flow on each sw to sw edge, -1 per unit of gamma
+double multiserver_objective(Net_Topo &net_topo, Multiserver_Results &results)
+{
+    double objective = 0;
+    for (size_t s = 0; s < net_topo.ServerSideOFSWs.size(); s++)
+        for (size_t c = 0; c < net_topo.ClientSideOFSWs.size(); c++)
+            objective -= 10 * results.r_sc_sol[s][c];
+    for (int i = net_topo.srv_qty; i < net_topo.core_qty; i++)
+    {
+        for (int j : net_topo.neighbours(i))
+        {
+            if (j < net_topo.srv_qty)
+                continue;
+            objective -= results.gamma_ij_sol[i][j];
+            for (size_t s = 0; s < net_topo.ServerSideOFSWs.size(); s++)
+                for (size_t c = 0; c < net_topo.ClientSideOFSWs.size(); c++)
+                    objective += results.f_sc_ij_sol[s][c][i][j];
+        }
+    }
+    return objective;
+}
+
+// --bench-native: the native flow engine against the multiserver LP on random topologies of 5 to 10 sws with 1 to 3 sssws and
+// 1 to 3 cssws. Objectives are compared with the LP's weights. With one sssw they're expected to be equal. With more sssws the LP
+// can be lower, it has no conservation rows at the other sssws and cssws and ends flows there, the engine doesn't.
+void bench_native_engine()
+{
+    std::mt19937 rng(6);
+    std::string topology_path = (fs::temp_directory_path() / "frog_bench_native.topo").string();
+    std::array<int, 5> capacities = {100, 500, 1000, 2500, 25000};
+    int const topology_qty = 60;
+    int single_sssw = 0, single_sssw_equal = 0, multi_sssw_equal = 0, native_lower = 0;
+    double worst_gap = 0;
+    std::chrono::duration<double, std::milli> lp_time(0), native_time(0);
+    for (int t = 0; t < topology_qty; t++)
+    {
+        int sw_qty = std::uniform_int_distribution<int>(5, 10)(rng);
+        int sssw_qty = std::uniform_int_distribution<int>(1, 3)(rng);
+        int cssw_qty = std::uniform_int_distribution<int>(1, 3)(rng);
+        {
+            std::ofstream topo(topology_path, std::ios::trunc);
+            std::vector<std::string> roles(sw_qty, "");
+            std::fill(roles.begin(), roles.begin() + sssw_qty, "server_side");
+            std::fill(roles.begin() + sssw_qty, roles.begin() + sssw_qty + cssw_qty, "client_side");
+            std::shuffle(roles.begin(), roles.end(), rng);
+            std::vector<int> server_side;
+            for (int i = 0; i < sw_qty; i++)
+            {
+                topo << "switch s" << i << " " << roles[i] << "\n";
+                if (roles[i] == "server_side")
+                    server_side.push_back(i);
+            }
+            topo << "server srv1 10.0.0.200\nserver srv2 10.0.0.201\n";
+            topo << "link srv1 s" << server_side.front() << " 1000\nlink srv2 s" << server_side.back() << " 1000\n";
+            std::set<std::pair<int, int>> links;
+            for (int l = 0; l < 2 * sw_qty; l++)
+            {
+                int a = std::uniform_int_distribution<int>(0, sw_qty - 1)(rng);
+                int b = std::uniform_int_distribution<int>(0, sw_qty - 1)(rng);
+                if (a != b && !links.count({b, a}) && links.insert({a, b}).second)
+                    topo << "link s" << a << " s" << b << " " << capacities[std::uniform_int_distribution<int>(0, capacities.size() - 1)(rng)] << "\n";
+            }
+        }
+        Net_Topo net_topo(10, topology_path);
+
+        Multiserver_LP multiserver_lp(net_topo);
+        auto solve_start = std::chrono::steady_clock::now();
+        bool solved = multiserver_lp.solve();
+        lp_time += std::chrono::steady_clock::now() - solve_start;
+        if (!solved)
+        {
+            cout << "topology " << t << ": LP not solved\n";
+            continue;
+        }
+        multiserver_lp.get_solution();
+        double lp_objective = multiserver_objective(net_topo, multiserver_lp);
+
+        Multiserver_Native multiserver_native_engine(net_topo);
+        solve_start = std::chrono::steady_clock::now();
+        multiserver_native_engine.solve();
+        native_time += std::chrono::steady_clock::now() - solve_start;
+        double native_objective = multiserver_objective(net_topo, multiserver_native_engine);
+
+        double gap = native_objective - lp_objective;
+        bool equal = std::abs(gap) <= 1e-6 * std::max(1.0, std::abs(lp_objective));
+        single_sssw += sssw_qty == 1;
+        single_sssw_equal += sssw_qty == 1 && equal;
+        multi_sssw_equal += sssw_qty > 1 && equal;
+        native_lower += !equal && gap < 0;
+        worst_gap = std::max(worst_gap, std::abs(gap) / std::max(1.0, std::abs(lp_objective)));
+        if (!equal)
+            cout << "topology " << t << ": " << sssw_qty << " sssws, LP objective " << lp_objective << ", native " << native_objective << "\n";
+    }
+    fs::remove(topology_path);
+
+    cout << "native engine against multiserver LP on " << topology_qty << " topologies:\n";
+    cout << "  one sssw   : " << single_sssw_equal << " of " << single_sssw << " with the LP's objective\n";
+    cout << "  more sssws : " << multi_sssw_equal << " of " << topology_qty - single_sssw << " with the LP's objective, largest relative gap " << worst_gap
+         << (native_lower ? ", native lower than the LP on some, check them" : "") << "\n";
+    cout << "  solve time : LP " << lp_time.count() / topology_qty << " ms, native " << native_time.count() / topology_qty << " ms per topology\n";
+}
+
+// Synthetic client history and layer rates for the benchmarks
+void set_bench_clients(Net_Topo &net_topo, int m_c, std::mt19937 &rng, Demand_Model &b_bar_cl)
+{
+    int requests = net_topo.requests_qty;
+    lambda_bar_c.assign(requests, 0);
+    l_bar_c.assign(requests, 0);
+    mu_bar_c.assign(requests, 0);
+    v_bar_c.assign(requests, 0);
+    b_bar_cl.reset(requests, m_c, net_topo.client_cssw, net_topo.ClientSideOFSWs.size());
+    const double layer_rates[] = {1.0, 0.6, 0.8, 1.2}; // Mbps
+    std::vector<double> client_rates(m_c);
+    for (int c = 0; c < requests; c++)
+    {
+        l_bar_c[c] = std::uniform_int_distribution<int>(1, m_c)(rng);
+        lambda_bar_c[c] = l_bar_c[c];
+        mu_bar_c[c] = std::uniform_int_distribution<int>(0, 3)(rng);
+        v_bar_c[c] = std::uniform_int_distribution<int>(0, 2)(rng);
+        for (int l = 0; l < m_c; l++)
+            client_rates[l] = layer_rates[l % 4] * std::uniform_real_distribution<double>(0.8, 1.2)(rng);
+        b_bar_cl.assign(c, b_bar_cl.add_row(client_rates.data())); // clients of the benchmarks don't share rows
+    }
+}
+
+// one master() call with the state optimizer keeps for it, quality of each client is returned
+bool run_bench_master(Master_MILP &master_milp, Net_Topo &net_topo, const Demand_Model &b_bar_cl, int m_c, int phi_c, IloNumArray2 &r_sc_sol, IloNumArray2 &gamma_ij_sol,
+                      vector<double> &provided_rate_for_c, int segment_index, std::vector<int> &quality)
+{
+    int requests = net_topo.requests_qty;
+    int cssw_qty = net_topo.ClientSideOFSWs.size();
+    IloRangeArray master_FeasCutArray(master_milp.env);
+    IloNumArray2 r_sc_gamma_sol(master_milp.env);
+    std::map<int, double> req_max_rates_from_cssws; // master() looks every cssw up
+    for (int y = 0; y < cssw_qty; y++)
+        req_max_rates_from_cssws[y + net_topo.srv_qty + net_topo.OF_SWs.size()] = b_bar_cl.cssw_rate(y);
+    vector<vector<int>> r_sc_w_s_cl_count(net_topo.ServerSideOFSWs.size(), vector<int>(cssw_qty));
+    std::map<int, std::vector<int>> sorted_r_sc_sol;
+    std::set<int> sending_sssws;
+    std::vector<std::vector<int>> combinations;
+    int total_w_s_cl_max = requests * m_c, total_w_s_cl_ub = total_w_s_cl_max, last_infeas_total_w_s_cl = total_w_s_cl_max;
+    int counter = 0, nCr_counter = 0, r_value = 1, addition_to_sub_layer = 0, inc_cancelled = 0, total_w_s_cl_result = 0, total_w_s_cl_sol = 0;
+    bool need_inc_add_sub_layer = false, dec_buff_for_master = false, master_solved = false;
+    master(master_milp, requests, b_bar_cl, net_topo, m_c, phi_c, total_w_s_cl_ub, total_w_s_cl_max, r_sc_sol, r_sc_gamma_sol, counter,
+           req_max_rates_from_cssws, gamma_ij_sol, r_sc_w_s_cl_count, master_FeasCutArray, sorted_r_sc_sol, sending_sssws, combinations,
+           nCr_counter, r_value, addition_to_sub_layer, need_inc_add_sub_layer, inc_cancelled, provided_rate_for_c, dec_buff_for_master, total_w_s_cl_result,
+           master_solved, last_infeas_total_w_s_cl, total_w_s_cl_sol, segment_index);
+    quality.assign(requests, 0);
+    for (int c = 0; c < requests; c++)
+        for (int l = 0; l < m_c; l++)
+            for (int s = 0; s < net_topo.srv_qty; s++)
+                quality[c] += master_milp.w_s_cl_sol[c][l][s] > 0.5;
+    return master_solved;
+}
+
+// Wall clock time and objective of the monolithic master MILP against the partitioned master (--groups, --threads) at 1k, 4k and
+// 10k clients, on the native multiserver engine's r_sc_sol with synthetic layer rates and client history. Both get 10 s.
+void bench_partition()
+{
+    int const m_c = 4;
+    int const segment_index = 1;
+    int const phi_c = 2;
+    double const time_limit = 10.0;
+    Thread_Pool pool(frog_options.threads > 0 ? frog_options.threads : std::thread::hardware_concurrency());
+    for (int requests : {1000, 4000, 10000})
+    {
+        Net_Topo net_topo(requests, frog_options.topology_file);
+        int cssw_qty = net_topo.ClientSideOFSWs.size();
+        int sssw_qty = net_topo.ServerSideOFSWs.size();
+        std::mt19937 rng(requests);
+        Demand_Model b_bar_cl;
+        set_bench_clients(net_topo, m_c, rng, b_bar_cl);
+
+        Multiserver_Native multiserver_engine(net_topo);
+        vector<double> provided_rate_for_c(cssw_qty);
+        multiserver_native(multiserver_engine, net_topo, provided_rate_for_c);
+        IloNumArray2 &r_sc_sol = multiserver_engine.r_sc_sol;
+
+        // monolithic
+        Master_MILP master_milp(net_topo, m_c);
+        auto monolithic_start = std::chrono::steady_clock::now();
+        master_milp.solve_deadline = monolithic_start + std::chrono::seconds((int)time_limit);
+        std::vector<int> monolithic_quality;
+        bool master_solved = run_bench_master(master_milp, net_topo, b_bar_cl, m_c, phi_c, r_sc_sol, multiserver_engine.gamma_ij_sol, provided_rate_for_c,
+                                              segment_index, monolithic_quality);
+        std::chrono::duration<double, std::milli> monolithic_time = std::chrono::steady_clock::now() - monolithic_start;
+
+        // partitioned
+        auto partitioned_start = std::chrono::steady_clock::now();
+        std::vector<int> w_fixed;
+        std::vector<int> last_sssw_of_cssw;
+        vector<vector<int>> r_sc_w_s_cl_count(sssw_qty, vector<int>(cssw_qty));
+        std::map<int, std::vector<int>> sorted_r_sc_sol;
+        std::set<int> sending_sssws;
+        preassign_sssws(requests, b_bar_cl, net_topo, m_c, r_sc_sol, 1, r_sc_w_s_cl_count, sorted_r_sc_sol, sending_sssws, w_fixed, last_sssw_of_cssw);
+        Partitioned_Master partitioned(net_topo, m_c, pool, frog_options.groups);
+        partitioned.time_budget = time_limit;
+        bool partitioned_solved = partitioned.solve(b_bar_cl, r_sc_sol, w_fixed, last_sssw_of_cssw, segment_index);
+        std::chrono::duration<double, std::milli> partitioned_time = std::chrono::steady_clock::now() - partitioned_start;
+
+        cout << "clients: " << requests << "\n";
+        cout << "  monolithic             : " << monolithic_time.count() << " ms\tobjective ";
+        if (master_solved)
+            cout << partitioned.objective_of(monolithic_quality) << "\n";
+        else
+            cout << "no solution\n";
+        cout << "  partitioned (" << partitioned.group_qty << " groups, " << pool.size() << " threads): " << partitioned_time.count() << " ms\tobjective ";
+        if (partitioned_solved)
+            cout << partitioned.objective << " (" << partitioned.solved_groups << " groups solved, bound " << partitioned.lower_bound << ")\n";
+        else
+            cout << "no solution\n";
+    }
+}
+
+// Runs the master MILP over segment_qty segments of the synthetic clients like optimizer() does: native multiserver, master with
+// solve_time to its deadline, then the history update, with every client at the base layer when master has no solution.
+// Model options are set by the caller, report gets the model and the objective of the last solved segment at the end.
+void run_bench_segments(int m_c, int segment_qty, std::chrono::seconds solve_time, const std::function<void(Master_MILP &master_milp, double objective)> &report)
+{
+    int const requests = frog_options.requests_qty;
+    Net_Topo net_topo(requests, frog_options.topology_file);
+    std::mt19937 rng(requests);
+    Demand_Model b_bar_cl;
+    set_bench_clients(net_topo, m_c, rng, b_bar_cl);
+    Multiserver_Native multiserver_engine(net_topo);
+    vector<double> provided_rate_for_c(net_topo.ClientSideOFSWs.size());
+    Master_MILP master_milp(net_topo, m_c);
+    master_solve_runtimes.clear();
+    master_nodes.clear();
+    std::vector<int> quality;
+    double objective = 0;
+    for (int segment_index = 0; segment_index < segment_qty; segment_index++)
+    {
+        multiserver_native(multiserver_engine, net_topo, provided_rate_for_c);
+        master_milp.solve_deadline = std::chrono::steady_clock::now() + solve_time;
+        if (run_bench_master(master_milp, net_topo, b_bar_cl, m_c, segment_index + 1, multiserver_engine.r_sc_sol, multiserver_engine.gamma_ij_sol,
+                             provided_rate_for_c, segment_index, quality))
+            objective = master_milp.masterCplex.getObjValue();
+        else
+            quality.assign(requests, 1);
+        for (int c = 0; c < requests; c++)
+        {
+            mu_bar_c[c] += abs(quality[c] - l_bar_c[c]);
+            v_bar_c[c] += master_milp.v_c_sol[c];
+            l_bar_c[c] = quality[c];
+            lambda_bar_c[c] += quality[c];
+        }
+    }
+    report(master_milp, objective);
+}
+
+// total solve time (s) and nodes of the master solves logged since the last clear
+void bench_solve_totals(double &total_solve_time, long long &total_nodes)
+{
+    total_solve_time = 0;
+    total_nodes = 0;
+    for (size_t i = 0; i < master_solve_runtimes.size(); i++)
+    {
+        total_solve_time += master_solve_runtimes[i].count();
+        total_nodes += master_nodes[i];
+    }
+}
+
+// Master MILP size, nodes and solve time with IloAbs and with the up/down switch variables over a run of segments on the same
+// synthetic clients, history is carried from segment to segment like optimizer does
+void bench_switch_model()
+{
+    int const m_c = 4;
+    int const segment_qty = 6;
+    for (std::string switch_model : {"abs", "linear"})
+    {
+        frog_options.switch_model = switch_model;
+        run_bench_segments(m_c, segment_qty, std::chrono::seconds(10), [&](Master_MILP &master_milp, double)
+                           {
+            double total_solve_time;
+            long long total_nodes;
+            bench_solve_totals(total_solve_time, total_nodes);
+            IloCplex &masterCplex = master_milp.masterCplex;
+            cout << "switch model: " << switch_model << "\tclients: " << frog_options.requests_qty << "\tsegments solved: " << master_solve_runtimes.size() << "/" << segment_qty << "\n";
+            cout << "  model  : " << masterCplex.getNrows() << " rows, " << masterCplex.getNcols() << " columns (" << masterCplex.getNbinVars() << " binary), "
+                 << masterCplex.getNNZs() << " non-zeros\n";
+            cout << "  solve  : " << total_nodes << " nodes, " << total_solve_time << " s\n"; });
+    }
+}
+
+// --bench-quality-model: layer binaries against integer q_c on the same clients, 4 layers, over a few segments.
+// Root bound is the best bound of the last segment's model after a solve limited to the root node.
+void bench_quality_model()
+{
+    int const m_c = 4;
+    int const segment_qty = 3;
+    for (std::string quality_model : {"layers", "integer"})
+    {
+        frog_options.quality_model = quality_model;
+        run_bench_segments(m_c, segment_qty, std::chrono::seconds(30), [&](Master_MILP &master_milp, double objective)
+                           {
+            double total_solve_time;
+            long long total_nodes;
+            bench_solve_totals(total_solve_time, total_nodes);
+            IloCplex &masterCplex = master_milp.masterCplex;
+            masterCplex.setParam(IloCplex::Param::MIP::Limits::Nodes, 0);
+            masterCplex.setParam(IloCplex::Param::TimeLimit, 30);
+            masterCplex.solve();
+            double root_bound = masterCplex.getBestObjValue();
+            cout << "quality model: " << quality_model << "\tclients: " << frog_options.requests_qty << "\tlayers: " << m_c << "\tsegments solved: "
+                 << master_solve_runtimes.size() << "/" << segment_qty << "\n";
+            cout << "  model  : " << masterCplex.getNrows() << " rows, " << masterCplex.getNcols() << " columns (" << masterCplex.getNbinVars() << " binary, "
+                 << masterCplex.getNintVars() << " integer)\n";
+            cout << "  bound  : root " << root_bound << ", last objective " << objective << "\n";
+            cout << "  solve  : " << total_nodes << " nodes, " << total_solve_time << " s\n"; });
+    }
+}
+
+// --bench-demand: demand of 10k clients spread over 500 titles at different positions. Each cycle clients move to their next segment
+// and 2% of them start another title. b_bar_cl is built from sessions sorted by (title, segment), from sessions in client order,
+// and as a per client copy of rates like set_b_bar_cl did with one title.
+void bench_demand()
+{
+    int const clients = 10000;
+    int const title_qty = 500;
+    int const m_c = 4;
+    int const cycles = 50;
+    double const teta = 2.0;
+    std::mt19937 rng(title_qty);
+
+    std::vector<Catalog_Video> videos(title_qty);
+    std::vector<uint32_t> sizes;
+    for (int t = 0; t < title_qty; t++)
+    {
+        snprintf(videos[t].name, sizeof(videos[t].name), "title%d", t);
+        videos[t].segment_qty = std::uniform_int_distribution<int>(150, 1800)(rng); // 5 to 60 minutes of 2 s segments
+        videos[t].first_size = sizes.size();
+        for (uint32_t i = 0; i < videos[t].segment_qty * m_c; i++)
+            sizes.emplace_back(std::uniform_int_distribution<uint32_t>(50000, 400000)(rng));
+    }
+    std::string catalog_path = (fs::temp_directory_path() / "frog_bench_demand.cat").string();
+    write_segment_catalog(catalog_path, videos, m_c, sizes);
+    Segment_Catalog catalog(catalog_path);
+
+    // title popularity is Zipf-like, positions are uniform
+    std::vector<double> popularity(title_qty);
+    for (int t = 0; t < title_qty; t++)
+        popularity[t] = 1.0 / std::pow(t + 1, 0.8);
+    std::discrete_distribution<int> pick_title(popularity.begin(), popularity.end());
+    Client_Sessions sessions(clients);
+    std::vector<int> title(clients), segment(clients);
+    for (int c = 0; c < clients; c++)
+    {
+        title[c] = pick_title(rng);
+        segment[c] = std::uniform_int_distribution<int>(0, catalog.segment_qty(title[c]) - 1)(rng);
+    }
+
+    std::vector<int> client_cssw(clients);
+    for (int c = 0; c < clients; c++)
+        client_cssw[c] = c % 8;
+    Demand_Model b_bar_cl;
+    std::vector<Client_Sessions::Session> order;
+    vector2d copied(clients, vector<double>(m_c));
+    double sorted_ms = 0, client_order_ms = 0, copy_ms = 0, sort_ms = 0;
+    long long rows = 0;
+    double check = 0;
+    for (int cycle = 0; cycle < cycles; cycle++)
+    {
+        for (int c = 0; c < clients; c++)
+        {
+            if (++segment[c] >= catalog.segment_qty(title[c]) || std::uniform_real_distribution<double>(0, 1)(rng) < 0.02)
+            {
+                title[c] = pick_title(rng);
+                segment[c] = 0;
+            }
+            sessions.on_request(c, title[c], segment[c]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        sessions.sorted(order);
+        auto sorted_time = std::chrono::steady_clock::now();
+        b_bar_cl.reset(clients, m_c, client_cssw, 8);
+        set_b_bar_cl(b_bar_cl, order, m_c, catalog, teta);
+        auto end = std::chrono::steady_clock::now();
+        sort_ms += std::chrono::duration<double, std::milli>(sorted_time - start).count();
+        sorted_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        rows += b_bar_cl.row_qty();
+        check += b_bar_cl.total_rate();
+
+        for (int c = 0; c < clients; c++)
+            order[c] = {title[c], segment[c], c};
+        start = std::chrono::steady_clock::now();
+        b_bar_cl.reset(clients, m_c, client_cssw, 8);
+        set_b_bar_cl(b_bar_cl, order, m_c, catalog, teta);
+        client_order_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        check -= b_bar_cl.total_rate();
+
+        start = std::chrono::steady_clock::now();
+        double toMegabit = 8.0 / (1000 * 1000);
+        for (int c = 0; c < clients; c++)
+            for (int l = 0; l < m_c; l++)
+                copied[c][l] = (1.054 * (catalog.size(title[c], segment[c], l) + 500) * toMegabit) / teta;
+        copy_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    fs::remove(catalog_path);
+
+    cout << "demand: " << clients << " clients, " << title_qty << " titles, " << m_c << " layers, " << cycles << " cycles, "
+         << rows / cycles << " rate rows per cycle (" << rows * 100.0 / cycles / clients << "% of clients)\n";
+    cout << "  sorted sessions : " << sorted_ms / cycles << " ms per cycle (sort " << sort_ms / cycles << " ms)\n";
+    cout << "  client order    : " << client_order_ms / cycles << " ms per cycle\n";
+    cout << "  per client copy : " << copy_ms / cycles << " ms per cycle, " << clients * m_c * sizeof(double) << " bytes of rates against "
+         << rows / cycles * m_c * sizeof(double) + clients * sizeof(int) << "\n";
+    if (std::abs(check) > 1e-6)
+        cout << "  sorted and client order demands differ by " << check << "\n";
+}
+
 int main(int argc, char **argv)
 {
+    bool bench_topo = false;
+    bool bench_partitioned_master = false;
+    bool bench_switches = false;
+    bool bench_quality = false;
+    bool bench_demand_model = false;
+    bool bench_paths = false;
+    bool bench_links = false;
+    bool bench_native = false;
+    std::string metrics_to_read;
+    std::string media_to_catalog;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bench-topo")
+            bench_topo = true;
+        else if (arg == "--bench-partition")
+            bench_partitioned_master = true;
+        else if (arg == "--bench-switch-model")
+            bench_switches = true;
+        else if (arg == "--bench-quality-model")
+            bench_quality = true;
+        else if (arg == "--bench-demand")
+            bench_demand_model = true;
+        else if (arg == "--bench-paths")
+            bench_paths = true;
+        else if (arg == "--bench-link-events")
+            bench_links = true;
+        else if (arg == "--bench-native")
+            bench_native = true;
+        else if (arg.rfind("--link-events=", 0) == 0)
+            frog_options.link_events_file = arg.substr(14);
+        else if (arg.rfind("--k-paths=", 0) == 0)
+            frog_options.k_paths = std::stoi(arg.substr(10));
+        else if (arg.rfind("--topo=", 0) == 0)
+            frog_options.topology_file = arg.substr(7);
+        else if (arg.rfind("--clients=", 0) == 0)
+            frog_options.requests_qty = std::stoi(arg.substr(10));
+        else if (arg.rfind("--threads=", 0) == 0)
+            frog_options.threads = std::stoi(arg.substr(10));
+        else if (arg.rfind("--groups=", 0) == 0)
+            frog_options.groups = std::stoi(arg.substr(9));
+        else if (arg.rfind("--mip-start-reference=", 0) == 0)
+            frog_options.mip_start_reference = std::stoi(arg.substr(22));
+        else if (arg.rfind("--history=", 0) == 0)
+            frog_options.history = std::stoi(arg.substr(10));
+        else if (arg.rfind("--metrics-file=", 0) == 0)
+            frog_options.metrics_file = arg.substr(15);
+        else if (arg.rfind("--metrics-read=", 0) == 0)
+            metrics_to_read = arg.substr(15);
+        else if (arg.rfind("--catalog=", 0) == 0)
+            frog_options.catalog_file = arg.substr(10);
+        else if (arg.rfind("--video=", 0) == 0)
+            frog_options.video = arg.substr(8);
+        else if (arg.rfind("--build-catalog=", 0) == 0)
+            media_to_catalog = arg.substr(16);
+        else if (arg == "--switch-model=abs" || arg == "--switch-model=linear")
+            frog_options.switch_model = arg.substr(15);
+        else if (arg == "--quality-model=layers" || arg == "--quality-model=integer")
+            frog_options.quality_model = arg.substr(16);
+        else if (arg == "--lp-solver=cplex" || arg == "--lp-solver=paths" || arg == "--lp-solver=native")
+            frog_options.lp_solver = arg.substr(12);
+        else if (arg == "--master=full" || arg == "--master=aggregated" || arg == "--master=greedy" || arg == "--master=lagrangian" || arg == "--master=partitioned")
+            frog_options.master_model = arg.substr(9);
+        else if (arg == "--mip-start=off" || (arg.rfind("--mip-start=", 0) == 0 && mip_start_efforts().count(arg.substr(12))))
+            frog_options.mip_start = arg.substr(12);
+        else
+        {
+            cerr << "Unknown argument: " << arg << "\n";
+            return 1;
+        }
+    }
 
-    optimizer();
+    try
+    {
+        if (!media_to_catalog.empty())
+            build_segment_catalog(media_to_catalog, frog_options.catalog_file);
+        else if (!metrics_to_read.empty())
+        {
+            Metrics_Store store;
+            store.open_reader(metrics_to_read);
+            print_metrics(store);
+        }
+        else if (bench_topo)
+            bench_topology_store();
+        else if (bench_partitioned_master)
+            bench_partition();
+        else if (bench_switches)
+            bench_switch_model();
+        else if (bench_quality)
+            bench_quality_model();
+        else if (bench_demand_model)
+            bench_demand();
+        else if (bench_paths)
+            bench_path_formulation();
+        else if (bench_links)
+            bench_link_events();
+        else if (bench_native)
+            bench_native_engine();
+        else
+            optimizer();
+    }
+    catch (const std::exception &e)
+    {
+        cerr << "Exception caught: " << e.what() << endl;
+        return 1;
+    }
 
     return 0;
 }
\ No newline at end of file